@@ -0,0 +1,68 @@
+/**
+ * MongoDB Extension Async Worker Implementation
+ */
+
+#include "async_worker.h"
+
+AsyncWorker::AsyncWorker(size_t maxPending)
+    : m_maxPending(maxPending)
+    , m_stop(false)
+{
+}
+
+AsyncWorker::~AsyncWorker()
+{
+    Stop();
+}
+
+bool AsyncWorker::Post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop || m_queue.size() >= m_maxPending)
+            return false;
+
+        m_queue.push_back(std::move(job));
+        if (!m_thread.joinable())
+            m_thread = std::thread(&AsyncWorker::Run, this);
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void AsyncWorker::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+size_t AsyncWorker::GetPending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+void AsyncWorker::Run()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_stop)
+                return;
+
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        job();
+    }
+}
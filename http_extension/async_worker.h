@@ -0,0 +1,46 @@
+/**
+ * MongoDB Extension Async Worker
+ * A background thread for requests whose result only feeds thread-safe
+ * state (e.g. cache refreshes). Jobs must not call into SourceMod.
+ */
+
+#ifndef _ASYNC_WORKER_H_
+#define _ASYNC_WORKER_H_
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+
+class AsyncWorker
+{
+public:
+    explicit AsyncWorker(size_t maxPending);
+    ~AsyncWorker();
+
+    // Queue a job; returns false if the queue is full or the worker stopped.
+    // The thread is started on first use.
+    bool Post(std::function<void()> job);
+
+    // Drop queued jobs and join the thread (extension unload)
+    void Stop();
+
+    size_t GetPending() const;
+
+    // Set while stopping; pass to HttpServicePost so transfers abort early
+    const std::atomic<bool>* GetCancelFlag() const { return &m_stop; }
+
+private:
+    void Run();
+
+    size_t m_maxPending;
+    mutable std::mutex m_mutex;
+    std::deque<std::function<void()>> m_queue;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif // _ASYNC_WORKER_H_
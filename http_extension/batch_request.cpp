@@ -0,0 +1,102 @@
+/**
+ * MongoDB Extension Batch Request Implementation
+ */
+
+#include "batch_request.h"
+#include "http_transport.h"
+#include "json_utils.h"
+
+static const char* const WRITE_TYPES[] = { "insertOne", "insertMany", "updateOne", "updateMany", "deleteOne", "deleteMany" };
+static const char* const READ_TYPES[] = { "find", "findOne", "count" };
+
+bool BatchIsWriteType(const std::string& type)
+{
+    for (const char* name : WRITE_TYPES)
+    {
+        if (type == name)
+            return true;
+    }
+    return false;
+}
+
+bool BatchIsKnownType(const std::string& type)
+{
+    if (BatchIsWriteType(type))
+        return true;
+
+    for (const char* name : READ_TYPES)
+    {
+        if (type == name)
+            return true;
+    }
+    return false;
+}
+
+std::string BatchBuildOperation(const std::string& type, const std::string& quotedConnectionId,
+                                const std::string& quotedDatabase, const std::string& quotedCollection,
+                                const std::string& argumentsJson)
+{
+    std::string operation = "{\"type\":\"" + type + "\",\"connectionId\":" + quotedConnectionId +
+                            ",\"database\":" + quotedDatabase + ",\"collection\":" + quotedCollection;
+
+    // Splice the arguments' members in after the target
+    size_t first = JsonSkipWhitespace(argumentsJson, 1);
+    if (first < argumentsJson.length() && argumentsJson[first] != '}')
+        operation += "," + argumentsJson.substr(first);
+    else
+        operation += "}";
+    return operation;
+}
+
+bool BatchExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& operations,
+                  bool ordered, std::vector<BatchOperationResult>& results, std::string& error,
+                  size_t* responseBytes)
+{
+    results.clear();
+
+    std::string body = "{\"operations\":[";
+    for (size_t i = 0; i < operations.size(); i++)
+    {
+        if (i > 0)
+            body += ",";
+        body += operations[i];
+    }
+    body += std::string("],\"ordered\":") + (ordered ? "true" : "false") + "}";
+
+    std::string response, success, data, resultsJson;
+    long statusCode;
+    std::vector<std::string> elements;
+    bool transferred = HttpServicePost(url, body, apiKey, response, statusCode);
+    if (responseBytes)
+        *responseBytes = response.length();
+    if (!transferred)
+    {
+        error = "API service unreachable";
+        return false;
+    }
+
+    if (statusCode >= 400 || !JsonGetMember(response, "success", success) || success != "true" ||
+        !JsonGetMember(response, "data", data) || !JsonGetMember(data, "results", resultsJson) ||
+        !JsonSplitArray(resultsJson, elements) || elements.size() != operations.size())
+    {
+        std::string message;
+        error = JsonGetMember(response, "error", message) ? JsonUnquote(message)
+                                                          : "batch request failed with HTTP " + std::to_string(statusCode);
+        return false;
+    }
+
+    results.resize(elements.size());
+    for (size_t i = 0; i < elements.size(); i++)
+    {
+        BatchOperationResult& result = results[i];
+        std::string raw;
+        result.success = JsonGetMember(elements[i], "success", raw) && raw == "true";
+        if (!JsonGetMember(elements[i], "data", result.data))
+            result.data.clear();
+        if (JsonGetMember(elements[i], "code", raw))
+            result.code = JsonUnquote(raw);
+        if (JsonGetMember(elements[i], "error", raw))
+            result.error = JsonUnquote(raw);
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+/**
+ * MongoDB Extension Batch Request
+ * Sends operations on several collections to the API service's
+ * /api/v1/batch route in one request and reads the per-operation results
+ */
+
+#ifndef _BATCH_REQUEST_H_
+#define _BATCH_REQUEST_H_
+
+#include <string>
+#include <vector>
+
+// The service's limit on the operations of one batch
+const size_t BATCH_MAX_OPERATIONS = 1000;
+
+struct BatchOperationResult
+{
+    bool success;
+    std::string data;  // raw JSON, same shape as the single-operation route's data
+    std::string code;  // e.g. OPERATION_FAILED, SKIPPED
+    std::string error;
+};
+
+// Operation types the batch route runs; writes invalidate cached reads
+bool BatchIsKnownType(const std::string& type);
+bool BatchIsWriteType(const std::string& type);
+
+// Build one operation ({"type":...,"connectionId":...}) from its type, target and
+// the type's arguments as a compact JSON object ({"filter":...,"update":...})
+std::string BatchBuildOperation(const std::string& type, const std::string& quotedConnectionId,
+                                const std::string& quotedDatabase, const std::string& quotedCollection,
+                                const std::string& argumentsJson);
+
+// Send the operations and fill one result per operation. Returns false with
+// error set if the request itself failed; results are then empty.
+// responseBytes, if given, receives the size of the response body.
+bool BatchExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& operations,
+                  bool ordered, std::vector<BatchOperationResult>& results, std::string& error,
+                  size_t* responseBytes = nullptr);
+
+#endif // _BATCH_REQUEST_H_
@@ -0,0 +1,295 @@
+/**
+ * MongoDB Extension Bulk Write Implementation
+ */
+
+#include "bulk_write.h"
+#include "http_transport.h"
+#include "json_utils.h"
+#include "request_trace.h"
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <cstdlib>
+
+// Outcome of one chunk, merged into the result on the calling thread
+struct BulkWriteChunkResult
+{
+    BulkWriteChunkResult() : sent(false), unavailable(false), aborted(false), requestBytes(0), responseBytes(0), failed(0), inserted(0), matched(0), modified(0), deleted(0), upserted(0) {}
+
+    bool sent;
+    bool unavailable; // request failed and may be retried later
+    bool aborted;     // request broke off after it was sent, outcome unknown
+    size_t requestBytes;
+    size_t responseBytes;
+    size_t failed;
+    uint64_t inserted;
+    uint64_t matched;
+    uint64_t modified;
+    uint64_t deleted;
+    uint64_t upserted;
+    std::vector<BulkWriteError> errors; // indexes already in plugin numbering
+    std::vector<std::string> insertedIds; // insertMany: per document of the chunk, empty if not inserted
+};
+
+static uint64_t GetCount(const std::string& data, const char* key)
+{
+    std::string raw;
+    return JsonGetMember(data, key, raw) ? strtoull(raw.c_str(), nullptr, 10) : 0;
+}
+
+std::vector<BulkWriteChunk> BulkWriteSplit(const std::vector<std::string>& operations, size_t maxOps, size_t maxBytes)
+{
+    std::vector<BulkWriteChunk> chunks;
+    size_t i = 0;
+    while (i < operations.size())
+    {
+        BulkWriteChunk chunk = { i, 0 };
+        size_t bytes = 0;
+        while (i < operations.size() && chunk.count < maxOps &&
+               (chunk.count == 0 || bytes + operations[i].size() + 1 <= maxBytes))
+        {
+            bytes += operations[i].size() + 1; // separating comma
+            chunk.count++;
+            i++;
+        }
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+std::string BulkWriteBody(const std::vector<std::string>& operations, const BulkWriteChunk& chunk, bool ordered)
+{
+    std::string body = "{\"operations\":[";
+    for (size_t i = 0; i < chunk.count; i++)
+    {
+        if (i > 0)
+            body += ",";
+        body += operations[chunk.first + i];
+    }
+    body += std::string("],\"ordered\":") + (ordered ? "true" : "false") + "}";
+    return body;
+}
+
+static void SendChunk(const std::string& url, const std::string& apiKey, const std::vector<std::string>& operations,
+                      const BulkWriteChunk& chunk, bool ordered, const std::atomic<bool>* cancel,
+                      BulkWriteChunkResult& result)
+{
+    result.sent = true;
+
+    std::string body = BulkWriteBody(operations, chunk, ordered);
+    std::string response, success, data;
+    long statusCode;
+    bool transferred = HttpServicePost(url, body, apiKey, response, statusCode, cancel);
+    result.requestBytes = body.length();
+    result.responseBytes = response.length();
+    if (!transferred || statusCode >= 400 || !JsonGetMember(response, "success", success) || success != "true" ||
+        !JsonGetMember(response, "data", data))
+    {
+        result.unavailable = HttpServiceUnavailable(transferred, statusCode, response);
+        result.aborted = statusCode == HTTP_STATUS_ABORTED;
+        BulkWriteError error = { chunk.first, -1, "bulkWrite request for operations " + std::to_string(chunk.first) +
+                                 "-" + std::to_string(chunk.first + chunk.count - 1) +
+                                 (result.aborted ? " aborted, outcome unknown" : " failed") };
+        result.errors.push_back(error);
+        result.failed = chunk.count;
+        return;
+    }
+
+    result.inserted = GetCount(data, "insertedCount");
+    result.matched = GetCount(data, "matchedCount");
+    result.modified = GetCount(data, "modifiedCount");
+    result.deleted = GetCount(data, "deletedCount");
+    result.upserted = GetCount(data, "upsertedCount");
+
+    std::string writeErrors;
+    std::vector<std::string> elements;
+    if (!JsonGetMember(data, "writeErrors", writeErrors) || !JsonSplitArray(writeErrors, elements))
+        return;
+
+    for (const std::string& element : elements)
+    {
+        std::string index, code, message;
+        JsonGetMember(element, "index", index);
+        JsonGetMember(element, "code", code);
+        JsonGetMember(element, "message", message);
+
+        BulkWriteError error = { chunk.first + strtoul(index.c_str(), nullptr, 10), atoi(code.c_str()),
+                                 JsonUnquote(message) };
+        result.errors.push_back(error);
+        result.failed++;
+    }
+}
+
+// Send chunks one after another, or up to maxParallel at once when unordered.
+// An ordered run stops after the first chunk send() reports errors for.
+static void DispatchChunks(size_t count, bool ordered, size_t maxParallel, const std::function<bool(size_t)>& send)
+{
+    if (ordered || count == 1 || maxParallel <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!send(i) && ordered)
+                break;
+        }
+        return;
+    }
+
+    // Each thread takes the next unsent chunk until none are left; their
+    // requests join the caller's trace
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    size_t threadCount = count < maxParallel ? count : maxParallel;
+    RequestTraceScope* parent = RequestTraceScope::Current();
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&]() {
+            RequestTraceScope trace(parent);
+            size_t i;
+            while ((i = next++) < count)
+                send(i);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// Merge the chunk results; returns true if every operation was applied
+static bool MergeChunks(const std::vector<BulkWriteChunk>& chunks, const std::vector<BulkWriteChunkResult>& chunkResults,
+                        BulkWriteResult& result)
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const BulkWriteChunkResult& chunk = chunkResults[i];
+        if (!chunk.sent)
+        {
+            result.skipped += chunks[i].count;
+            result.unsent.push_back(chunks[i]);
+            continue;
+        }
+        if (chunk.unavailable)
+            result.unsent.push_back(chunks[i]);
+        if (chunk.aborted)
+            result.aborted += chunks[i].count;
+
+        result.requests++;
+        result.requestBytes += chunk.requestBytes;
+        result.responseBytes += chunk.responseBytes;
+        result.failed += chunk.failed;
+        result.insertedCount += chunk.inserted;
+        result.matchedCount += chunk.matched;
+        result.modifiedCount += chunk.modified;
+        result.deletedCount += chunk.deleted;
+        result.upsertedCount += chunk.upserted;
+        result.errors.insert(result.errors.end(), chunk.errors.begin(), chunk.errors.end());
+
+        for (size_t j = 0; j < chunk.insertedIds.size() && j < chunks[i].count; j++)
+            result.insertedIds[chunks[i].first + j] = chunk.insertedIds[j];
+    }
+
+    return result.errors.empty() && result.skipped == 0;
+}
+
+bool BulkWriteExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& operations,
+                      bool ordered, size_t maxParallel, BulkWriteResult& result, const std::atomic<bool>* cancel)
+{
+    result = BulkWriteResult();
+
+    std::vector<BulkWriteChunk> chunks = BulkWriteSplit(operations, BULK_WRITE_MAX_OPS, BULK_WRITE_MAX_BYTES);
+    std::vector<BulkWriteChunkResult> chunkResults(chunks.size());
+
+    DispatchChunks(chunks.size(), ordered, maxParallel, [&](size_t i) {
+        // Chunks not started before a cancel stay unsent
+        if (cancel && *cancel)
+            return false;
+        SendChunk(url, apiKey, operations, chunks[i], ordered, cancel, chunkResults[i]);
+        return chunkResults[i].errors.empty();
+    });
+
+    return MergeChunks(chunks, chunkResults, result);
+}
+
+std::string InsertManyBody(const std::vector<std::string>& documents, const BulkWriteChunk& chunk, bool ordered)
+{
+    std::string body = "{\"documents\":[";
+    for (size_t i = 0; i < chunk.count; i++)
+    {
+        if (i > 0)
+            body += ",";
+        body += documents[chunk.first + i];
+    }
+    body += std::string("],\"options\":{\"ordered\":") + (ordered ? "true" : "false") + "}}";
+    return body;
+}
+
+static void SendInsertChunk(const std::string& url, const std::string& apiKey, const std::vector<std::string>& documents,
+                            const BulkWriteChunk& chunk, bool ordered, BulkWriteChunkResult& result)
+{
+    result.sent = true;
+
+    std::string body = InsertManyBody(documents, chunk, ordered);
+    std::string response, success, data;
+    long statusCode;
+    bool transferred = HttpServicePost(url, body, apiKey, response, statusCode);
+    result.requestBytes = body.length();
+    result.responseBytes = response.length();
+    if (!transferred || statusCode >= 400 || !JsonGetMember(response, "success", success) || success != "true" ||
+        !JsonGetMember(response, "data", data))
+    {
+        result.unavailable = HttpServiceUnavailable(transferred, statusCode, response);
+        BulkWriteError error = { chunk.first, -1, "insertMany request for documents " + std::to_string(chunk.first) +
+                                 "-" + std::to_string(chunk.first + chunk.count - 1) + " failed" };
+        result.errors.push_back(error);
+        result.failed = chunk.count;
+        return;
+    }
+
+    result.inserted = GetCount(data, "insertedCount");
+
+    // Ids are aligned with the chunk's documents; null for documents that were not inserted
+    std::string ids;
+    std::vector<std::string> elements;
+    if (JsonGetMember(data, "insertedIds", ids) && JsonSplitArray(ids, elements))
+    {
+        result.insertedIds.resize(elements.size());
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            if (elements[i] != "null")
+                result.insertedIds[i] = JsonUnquote(elements[i]);
+        }
+    }
+
+    std::string writeErrors;
+    elements.clear();
+    if (!JsonGetMember(data, "writeErrors", writeErrors) || !JsonSplitArray(writeErrors, elements))
+        return;
+
+    for (const std::string& element : elements)
+    {
+        std::string index, code, message;
+        JsonGetMember(element, "index", index);
+        JsonGetMember(element, "code", code);
+        JsonGetMember(element, "message", message);
+
+        BulkWriteError error = { chunk.first + strtoul(index.c_str(), nullptr, 10), atoi(code.c_str()),
+                                 JsonUnquote(message) };
+        result.errors.push_back(error);
+    }
+    result.failed = chunk.count - result.inserted;
+}
+
+bool InsertManyExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& documents,
+                       bool ordered, size_t maxParallel, BulkWriteResult& result)
+{
+    result = BulkWriteResult();
+    result.insertedIds.resize(documents.size());
+
+    std::vector<BulkWriteChunk> chunks = BulkWriteSplit(documents, INSERT_MANY_CHUNK_DOCUMENTS, BULK_WRITE_MAX_BYTES);
+    std::vector<BulkWriteChunkResult> chunkResults(chunks.size());
+
+    DispatchChunks(chunks.size(), ordered, maxParallel, [&](size_t i) {
+        SendInsertChunk(url, apiKey, documents, chunks[i], ordered, chunkResults[i]);
+        return chunkResults[i].errors.empty();
+    });
+
+    return MergeChunks(chunks, chunkResults, result);
+}
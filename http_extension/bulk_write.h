@@ -0,0 +1,81 @@
+/**
+ * MongoDB Extension Bulk Write
+ * Splits a plugin's bulk operations into requests the API service accepts
+ * and merges the per-request results
+ */
+
+#ifndef _BULK_WRITE_H_
+#define _BULK_WRITE_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+struct BulkWriteError
+{
+    size_t index;        // position in the plugin's operations list
+    int code;            // MongoDB error code, or -1 if the request itself failed
+    std::string message;
+};
+
+// A run of operations sent as one request: [first, first + count)
+struct BulkWriteChunk
+{
+    size_t first;
+    size_t count;
+};
+
+struct BulkWriteResult
+{
+    uint64_t insertedCount;
+    uint64_t matchedCount;
+    uint64_t modifiedCount;
+    uint64_t deletedCount;
+    uint64_t upsertedCount;
+    size_t requests;         // bulkWrite or insertMany requests sent
+    size_t requestBytes;     // bodies of the requests sent
+    size_t responseBytes;    // bodies of their responses
+    size_t skipped;          // operations not sent because an ordered write stopped
+    size_t failed;           // operations sent but not applied, including whole failed requests
+    size_t spooled;          // operations the caller journaled to the write spool instead
+    size_t aborted;          // operations of requests that broke off after sending; they may have been applied
+    std::vector<BulkWriteError> errors;
+    std::vector<BulkWriteChunk> unsent; // chunks not sent, or sent while the service was unavailable
+    std::vector<std::string> insertedIds; // InsertManyExecute: per document, empty if not inserted
+};
+
+// Stay below MongoDB's maxWriteBatchSize and the service's 10 MB body limit
+const size_t BULK_WRITE_MAX_OPS = 100000;
+const size_t BULK_WRITE_MAX_BYTES = 8 * 1024 * 1024;
+
+// Documents per insertMany request; small enough that large imports spread over parallel requests
+const size_t INSERT_MANY_CHUNK_DOCUMENTS = 1000;
+
+// Split operations into chunks of at most maxOps operations and roughly maxBytes
+// of request body. An operation larger than maxBytes gets a chunk of its own.
+std::vector<BulkWriteChunk> BulkWriteSplit(const std::vector<std::string>& operations, size_t maxOps, size_t maxBytes);
+
+// Request body of one chunk
+std::string BulkWriteBody(const std::vector<std::string>& operations, const BulkWriteChunk& chunk, bool ordered);
+
+// Send operations (compact JSON objects) to a bulkWrite URL. Ordered writes go
+// chunk by chunk and stop at the first chunk with an error; unordered writes
+// send up to maxParallel chunks at once. Safe to call from any thread.
+// Setting *cancel aborts the requests in progress: chunks not sent yet end up
+// in result.unsent, chunks already sent count as failed and as aborted.
+// Returns true if every operation was written.
+bool BulkWriteExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& operations,
+                      bool ordered, size_t maxParallel, BulkWriteResult& result,
+                      const std::atomic<bool>* cancel = nullptr);
+
+// Request body of one insertMany chunk
+std::string InsertManyBody(const std::vector<std::string>& documents, const BulkWriteChunk& chunk, bool ordered);
+
+// Insert documents (compact JSON objects) through an insertMany URL, in chunks
+// dispatched like BulkWriteExecute's. result.insertedIds is filled in
+// document order. Returns true if every document was inserted.
+bool InsertManyExecute(const std::string& url, const std::string& apiKey, const std::vector<std::string>& documents,
+                       bool ordered, size_t maxParallel, BulkWriteResult& result);
+
+#endif // _BULK_WRITE_H_
@@ -0,0 +1,350 @@
+/**
+ * MongoDB Extension Change Streams Implementation
+ *
+ * Each subscription runs on its own thread and never calls into SourceMod;
+ * it only talks to the (thread-safe) DocumentCache.
+ */
+
+#include "change_stream.h"
+#include "document_cache.h"
+#include "json_utils.h"
+#include <curl/curl.h>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+// Reconnect delays in seconds
+static const int RECONNECT_DELAY_MIN = 1;
+static const int RECONNECT_DELAY_MAX = 30;
+
+// The service sends a heartbeat every 15 seconds
+static const long STREAM_IDLE_TIMEOUT = 45;
+
+class ChangeStreamManager::Subscription
+{
+public:
+    Subscription(DocumentCache& cache, const std::string& collectionKey,
+                 const std::string& streamUrl, const std::string& apiKey)
+        : refCount(1)
+        , m_cache(cache)
+        , m_collectionKey(collectionKey)
+        , m_streamUrl(streamUrl)
+        , m_apiKey(apiKey)
+        , m_connected(false)
+        , m_events(0)
+        , m_stop(false)
+        , m_finished(false)
+        , m_opened(false)
+    {
+        m_thread = std::thread(&Subscription::Run, this);
+    }
+
+    ~Subscription()
+    {
+        RequestStop();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Make the thread end without waiting for it; the stream aborts within about a second
+    void RequestStop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_waitMutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+    }
+
+    // The thread is done, so destroying the subscription does not block
+    bool IsFinished() const { return m_finished; }
+
+    bool IsConnected() const { return m_connected; }
+    int GetEventCount() const { return m_events; }
+
+    int refCount;
+
+private:
+    void Run()
+    {
+        int delay = RECONNECT_DELAY_MIN;
+        while (!m_stop)
+        {
+            m_opened = false;
+            ReadStream();
+            m_connected = false;
+
+            if (m_stop)
+                break;
+
+            // Back off while the service keeps refusing the stream
+            delay = m_opened ? RECONNECT_DELAY_MIN : std::min(delay * 2, RECONNECT_DELAY_MAX);
+
+            std::unique_lock<std::mutex> lock(m_waitMutex);
+            m_wake.wait_for(lock, std::chrono::seconds(delay), [this] { return m_stop.load(); });
+        }
+        m_finished = true;
+    }
+
+    void ReadStream()
+    {
+        CURL* curl = curl_easy_init();
+        if (!curl)
+            return;
+
+        struct curl_slist* headers = nullptr;
+        headers = curl_slist_append(headers, "Accept: text/event-stream");
+        headers = curl_slist_append(headers, "User-Agent: SourceMod-MongoDB-Extension/1.0");
+        headers = curl_slist_append(headers, "X-SourceMod-Extension: MongoDB-HTTP-Extension");
+        headers = curl_slist_append(headers, "X-Extension-Version: 1.0.0");
+
+        std::string authHeader = "X-SourceMod-API-Key: " + m_apiKey;
+        headers = curl_slist_append(headers, authHeader.c_str());
+
+        // Ask the service to resume after the last event we handled
+        std::string resumeHeader;
+        if (!m_resumeToken.empty())
+        {
+            resumeHeader = "Last-Event-ID: " + m_resumeToken;
+            headers = curl_slist_append(headers, resumeHeader.c_str());
+        }
+
+        m_buffer.clear();
+
+        curl_easy_setopt(curl, CURLOPT_URL, m_streamUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, STREAM_IDLE_TIMEOUT);
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L); // Matches EnhancedHTTPPost
+
+        curl_easy_perform(curl);
+
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+    }
+
+    static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp)
+    {
+        Subscription* self = static_cast<Subscription*>(userp);
+        size_t totalSize = size * nmemb;
+        if (self->m_stop)
+            return 0; // abort the transfer
+
+        self->m_buffer.append(static_cast<char*>(contents), totalSize);
+        self->ParseEvents();
+        return totalSize;
+    }
+
+    static int ProgressCallback(void* userp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        Subscription* self = static_cast<Subscription*>(userp);
+        return self->m_stop ? 1 : 0;
+    }
+
+    // Split the buffer into server-sent events (blocks separated by a blank line)
+    void ParseEvents()
+    {
+        m_buffer.erase(std::remove(m_buffer.begin(), m_buffer.end(), '\r'), m_buffer.end());
+
+        size_t end;
+        while ((end = m_buffer.find("\n\n")) != std::string::npos)
+        {
+            std::string block = m_buffer.substr(0, end);
+            m_buffer.erase(0, end + 2);
+
+            std::string event = "message", data, id;
+            size_t pos = 0;
+            while (pos <= block.length())
+            {
+                size_t lineEnd = block.find('\n', pos);
+                if (lineEnd == std::string::npos)
+                    lineEnd = block.length();
+                std::string line = block.substr(pos, lineEnd - pos);
+                pos = lineEnd + 1;
+
+                if (line.empty() || line[0] == ':')
+                    continue; // heartbeat comment
+
+                size_t colon = line.find(':');
+                std::string field = line.substr(0, colon);
+                std::string value = colon == std::string::npos ? "" : line.substr(colon + 1);
+                if (!value.empty() && value[0] == ' ')
+                    value.erase(0, 1);
+
+                if (field == "event")
+                    event = value;
+                else if (field == "data")
+                    data += data.empty() ? value : "\n" + value;
+                else if (field == "id")
+                    id = value;
+            }
+
+            HandleEvent(event, data);
+            if (!id.empty())
+                m_resumeToken = id;
+        }
+    }
+
+    void HandleEvent(const std::string& event, const std::string& data)
+    {
+        if (event == "ready")
+        {
+            m_opened = true;
+            m_connected = true;
+
+            // Without a resume we cannot know what changed while we were away
+            std::string resumed;
+            if (!JsonGetMember(data, "resumed", resumed) || resumed != "true")
+                m_cache.InvalidateCollection(m_collectionKey);
+        }
+        else if (event == "change")
+        {
+            m_events++;
+
+            std::string operation, documentKey, documentId;
+            JsonGetMember(data, "operationType", operation);
+            operation = JsonUnquote(operation);
+
+            if (operation == "insert")
+            {
+                m_cache.InvalidateMissing(m_collectionKey);
+            }
+            else if ((operation == "update" || operation == "replace" || operation == "delete") &&
+                     JsonGetMember(data, "documentKey", documentKey) &&
+                     JsonGetMember(documentKey, "_id", documentId))
+            {
+                m_cache.InvalidateDocument(m_collectionKey, JsonUnquote(documentId));
+            }
+            else
+            {
+                // drop, rename, invalidate or an event we cannot map to a document
+                m_cache.InvalidateCollection(m_collectionKey);
+            }
+        }
+        else if (event == "error")
+        {
+            // The service could not keep the stream (e.g. resume token too old);
+            // start over without resuming on the next attempt
+            m_resumeToken.clear();
+            m_cache.InvalidateCollection(m_collectionKey);
+        }
+    }
+
+    DocumentCache& m_cache;
+    std::string m_collectionKey;
+    std::string m_streamUrl;
+    std::string m_apiKey;
+
+    std::atomic<bool> m_connected;
+    std::atomic<int> m_events;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_finished;
+    bool m_opened;
+
+    // Only touched by the stream thread
+    std::string m_buffer;
+    std::string m_resumeToken;
+
+    std::mutex m_waitMutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+};
+
+ChangeStreamManager::ChangeStreamManager(DocumentCache& cache)
+    : m_cache(cache)
+{
+}
+
+ChangeStreamManager::~ChangeStreamManager()
+{
+    StopAll();
+}
+
+bool ChangeStreamManager::Subscribe(const std::string& collectionKey, const std::string& streamUrl,
+                                    const std::string& apiKey)
+{
+    std::vector<std::unique_ptr<Subscription>> finished;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TakeFinishedLocked(finished);
+    auto it = m_subscriptions.find(collectionKey);
+    if (it != m_subscriptions.end())
+    {
+        it->second->refCount++;
+        return true;
+    }
+
+    m_subscriptions[collectionKey].reset(new Subscription(m_cache, collectionKey, streamUrl, apiKey));
+    return true;
+}
+
+void ChangeStreamManager::Unsubscribe(const std::string& collectionKey)
+{
+    std::vector<std::unique_ptr<Subscription>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TakeFinishedLocked(finished);
+        auto it = m_subscriptions.find(collectionKey);
+        if (it == m_subscriptions.end() || --it->second->refCount > 0)
+            return;
+
+        // The game thread calls this; joining here would stall it until the
+        // stream aborts, so the thread is joined once it has ended
+        it->second->RequestStop();
+        m_stopping.push_back(std::move(it->second));
+        m_subscriptions.erase(it);
+    }
+}
+
+void ChangeStreamManager::StopAll()
+{
+    std::map<std::string, std::unique_ptr<Subscription>> stopped;
+    std::vector<std::unique_ptr<Subscription>> stopping;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stopped.swap(m_subscriptions);
+        stopping.swap(m_stopping);
+    }
+    // Stop every thread first so they abort in parallel, then join them
+    for (auto& entry : stopped)
+        entry.second->RequestStop();
+}
+
+void ChangeStreamManager::TakeFinishedLocked(std::vector<std::unique_ptr<Subscription>>& finished)
+{
+    for (auto it = m_stopping.begin(); it != m_stopping.end();)
+    {
+        if ((*it)->IsFinished())
+        {
+            finished.push_back(std::move(*it));
+            it = m_stopping.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool ChangeStreamManager::IsConnected(const std::string& collectionKey) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_subscriptions.find(collectionKey);
+    return it != m_subscriptions.end() && it->second->IsConnected();
+}
+
+int ChangeStreamManager::GetEventCount(const std::string& collectionKey) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_subscriptions.find(collectionKey);
+    return it != m_subscriptions.end() ? it->second->GetEventCount() : 0;
+}
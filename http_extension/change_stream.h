@@ -0,0 +1,50 @@
+/**
+ * MongoDB Extension Change Streams
+ * Background subscriptions to the API service's change event stream,
+ * used to keep the document cache coherent when other servers write
+ */
+
+#ifndef _CHANGE_STREAM_H_
+#define _CHANGE_STREAM_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+class DocumentCache;
+
+class ChangeStreamManager
+{
+public:
+    explicit ChangeStreamManager(DocumentCache& cache);
+    ~ChangeStreamManager();
+
+    // Start a subscription for a collection, or add a reference to the running one
+    bool Subscribe(const std::string& collectionKey, const std::string& streamUrl, const std::string& apiKey);
+
+    // Drop one reference; the stream is stopped when the last one goes away.
+    // Does not wait for its thread, which is joined once it has ended.
+    void Unsubscribe(const std::string& collectionKey);
+
+    // Stop every stream and wait for the threads (extension unload)
+    void StopAll();
+
+    bool IsConnected(const std::string& collectionKey) const;
+    int GetEventCount(const std::string& collectionKey) const;
+
+private:
+    class Subscription;
+
+    // Move stopped subscriptions whose thread has ended to finished, which
+    // joins them when it is destroyed outside the lock
+    void TakeFinishedLocked(std::vector<std::unique_ptr<Subscription>>& finished);
+
+    DocumentCache& m_cache;
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<Subscription>> m_subscriptions; // collection key -> stream
+    std::vector<std::unique_ptr<Subscription>> m_stopping; // unsubscribed, thread not joined yet
+};
+
+#endif // _CHANGE_STREAM_H_
@@ -6,6 +6,10 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
 #ifndef SOURCEMOD_BUILD
 #include <iostream>
 #endif
@@ -19,6 +23,27 @@ ConfigManager::ConfigManager()
     , m_defaultDatabase("sourcemod")
     , m_maxConnections(5)
     , m_idleTimeout(300)
+    , m_cachingEnabled(true)
+    , m_cacheTTL(300)
+    , m_batchSize(100)
+    , m_cacheMaxMemory(32)
+    , m_cacheCollectionQuota(50)
+    , m_sharedCacheEnabled(false)
+    , m_sharedCacheName("/sm_mongodb_cache")
+    , m_sharedCacheSize(16)
+    , m_sharedCacheSlotSize(4096)
+    , m_writeBehindInterval(1000)
+    , m_coalesceInterval(5000)
+    , m_writeSpoolEnabled(false)
+    , m_writeSpoolMaxSize(64)
+    , m_flushTimeout(2000)
+    , m_stallThreshold(2000)
+    , m_traceSampleRate(100)
+    , m_profilingEnabled(false)
+    , m_slowQueryThreshold(1000)
+    , m_logQueries(false)
+    , m_maxLogSize(10 * 1024 * 1024)
+    , m_logRotation(true)
 {
 }
 
@@ -39,6 +64,27 @@ bool ConfigManager::LoadConfig(const char* configPath)
     m_defaultDatabase = "sourcemod";
     m_maxConnections = 5;
     m_idleTimeout = 300;
+    m_cachingEnabled = true;
+    m_cacheTTL = 300;
+    m_batchSize = 100;
+    m_cacheMaxMemory = 32;
+    m_cacheCollectionQuota = 50;
+    m_sharedCacheEnabled = false;
+    m_sharedCacheName = "/sm_mongodb_cache";
+    m_sharedCacheSize = 16;
+    m_sharedCacheSlotSize = 4096;
+    m_writeBehindInterval = 1000;
+    m_coalesceInterval = 5000;
+    m_writeSpoolEnabled = false;
+    m_writeSpoolMaxSize = 64;
+    m_flushTimeout = 2000;
+    m_stallThreshold = 2000;
+    m_traceSampleRate = 100;
+    m_profilingEnabled = false;
+    m_slowQueryThreshold = 1000;
+    m_logQueries = false;
+    m_maxLogSize = 10 * 1024 * 1024;
+    m_logRotation = true;
 
     // Try to open and parse the JSON config file
     std::ifstream file(configPath);
@@ -94,6 +140,102 @@ bool ConfigManager::ParseJSON(const std::string& jsonContent)
             m_idleTimeout = ExtractJSONInt(connSection, "keep_alive", 300);
         }
 
+        // Parse performance section
+        std::string perfSection = ExtractJSONSection(jsonContent, "performance");
+        if (!perfSection.empty())
+        {
+            m_cachingEnabled = ExtractJSONBool(perfSection, "enable_caching", true);
+            m_cacheTTL = ExtractJSONInt(perfSection, "cache_ttl", 300);
+            m_batchSize = ExtractJSONInt(perfSection, "batch_size", 100);
+            if (m_batchSize < 1)
+                m_batchSize = 1;
+            else if (m_batchSize > 1000)
+                m_batchSize = 1000;
+
+            m_cacheMaxMemory = ExtractJSONInt(perfSection, "cache_max_memory", 32);
+            if (m_cacheMaxMemory < 1)
+                m_cacheMaxMemory = 1;
+            else if (m_cacheMaxMemory > 1024)
+                m_cacheMaxMemory = 1024;
+            m_cacheCollectionQuota = ExtractJSONInt(perfSection, "cache_collection_quota", 50);
+            if (m_cacheCollectionQuota < 1)
+                m_cacheCollectionQuota = 1;
+            else if (m_cacheCollectionQuota > 100)
+                m_cacheCollectionQuota = 100;
+
+            m_sharedCacheEnabled = ExtractJSONBool(perfSection, "shared_cache", false);
+            m_sharedCacheName = ExtractJSONString(perfSection, "shared_cache_name", m_sharedCacheName);
+            if (m_sharedCacheName.empty() || m_sharedCacheName[0] != '/')
+                m_sharedCacheName = "/" + m_sharedCacheName;
+            m_sharedCacheSize = ExtractJSONInt(perfSection, "shared_cache_size", 16);
+            if (m_sharedCacheSize < 1)
+                m_sharedCacheSize = 1;
+            else if (m_sharedCacheSize > 1024)
+                m_sharedCacheSize = 1024;
+            m_sharedCacheSlotSize = ExtractJSONInt(perfSection, "shared_cache_slot_size", 4096);
+            if (m_sharedCacheSlotSize < 512)
+                m_sharedCacheSlotSize = 512;
+            else if (m_sharedCacheSlotSize > 65536)
+                m_sharedCacheSlotSize = 65536;
+
+            m_writeBehindInterval = ExtractJSONInt(perfSection, "write_behind_interval", 1000);
+            if (m_writeBehindInterval < 10)
+                m_writeBehindInterval = 10;
+            else if (m_writeBehindInterval > 60000)
+                m_writeBehindInterval = 60000;
+
+            m_coalesceInterval = ExtractJSONInt(perfSection, "coalesce_interval", 5000);
+            if (m_coalesceInterval < 100)
+                m_coalesceInterval = 100;
+            else if (m_coalesceInterval > 300000)
+                m_coalesceInterval = 300000;
+
+            m_writeSpoolEnabled = ExtractJSONBool(perfSection, "write_spool", false);
+            m_writeSpoolMaxSize = ExtractJSONInt(perfSection, "write_spool_max_size", 64);
+            if (m_writeSpoolMaxSize < 1)
+                m_writeSpoolMaxSize = 1;
+            else if (m_writeSpoolMaxSize > 1024)
+                m_writeSpoolMaxSize = 1024;
+
+            m_flushTimeout = ExtractJSONInt(perfSection, "flush_timeout", 2000);
+            if (m_flushTimeout < 100)
+                m_flushTimeout = 100;
+            else if (m_flushTimeout > 60000)
+                m_flushTimeout = 60000;
+
+            m_stallThreshold = ExtractJSONInt(perfSection, "stall_threshold", 2000);
+            if (m_stallThreshold < 100)
+                m_stallThreshold = 100;
+            else if (m_stallThreshold > 1000000)
+                m_stallThreshold = 1000000;
+
+            m_traceSampleRate = ExtractJSONInt(perfSection, "trace_sample_rate", 100);
+            if (m_traceSampleRate < 0)
+                m_traceSampleRate = 0;
+
+            m_profilingEnabled = ExtractJSONBool(perfSection, "enable_profiling", false);
+            m_slowQueryThreshold = ExtractJSONInt(perfSection, "slow_query_threshold", 1000);
+            if (m_slowQueryThreshold < 0)
+                m_slowQueryThreshold = 0;
+        }
+
+        // Parse logging section
+        std::string logSection = ExtractJSONSection(jsonContent, "logging");
+        if (!logSection.empty())
+        {
+            m_logQueries = ExtractJSONBool(logSection, "log_queries", false);
+            std::string maxLogSize = ExtractJSONString(logSection, "max_log_size", "10MB");
+            if (!ParseSize(maxLogSize, m_maxLogSize))
+            {
+                // Loading still succeeds; MongoDB_LoadConfig logs the warning
+                m_maxLogSize = 10 * 1024 * 1024;
+                m_lastError = "logging.max_log_size \"" + maxLogSize + "\" is not a valid size (or too large for this server), using 10MB";
+            }
+            if (m_maxLogSize < 64 * 1024)
+                m_maxLogSize = 64 * 1024;
+            m_logRotation = ExtractJSONBool(logSection, "log_rotation", true);
+        }
+
         // Parse development section
         std::string devSection = ExtractJSONSection(jsonContent, "development");
         if (!devSection.empty())
@@ -229,4 +371,42 @@ bool ConfigManager::ExtractJSONBool(const std::string& section, const std::strin
     return defaultValue;
 }
 
+// "10MB", "512KB", "1GB" or a plain byte count. Returns false for anything
+// else and for sizes size_t cannot hold (above 4 GB on 32-bit servers).
+bool ConfigManager::ParseSize(const std::string& size, size_t& bytes)
+{
+    const char* start = size.c_str();
+    while (*start == ' ')
+        start++;
+    if (!isdigit((unsigned char)*start))
+        return false; // strtoull would wrap a minus sign around
+
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = strtoull(start, &end, 10);
+    if (errno == ERANGE)
+        return false;
+
+    while (*end == ' ')
+        end++;
+    std::string unit = end;
+    for (char& c : unit)
+        c = (char)toupper((unsigned char)c);
+
+    unsigned long long multiplier;
+    if (unit.empty() || unit == "B")
+        multiplier = 1;
+    else if (unit == "KB" || unit == "K")
+        multiplier = 1024;
+    else if (unit == "MB" || unit == "M")
+        multiplier = 1024 * 1024;
+    else if (unit == "GB" || unit == "G")
+        multiplier = 1024 * 1024 * 1024;
+    else
+        return false;
 
+    if (value > SIZE_MAX / multiplier)
+        return false;
+    bytes = (size_t)(value * multiplier);
+    return true;
+}
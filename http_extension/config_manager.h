@@ -34,6 +34,28 @@ public:
     
     int GetMaxConnections() const { return m_maxConnections; }
     int GetIdleTimeout() const { return m_idleTimeout; }
+
+    bool IsCachingEnabled() const { return m_cachingEnabled; }
+    int GetCacheTTL() const { return m_cacheTTL; }
+    int GetBatchSize() const { return m_batchSize; }
+    int GetCacheMaxMemory() const { return m_cacheMaxMemory; }
+    int GetCacheCollectionQuota() const { return m_cacheCollectionQuota; }
+    bool IsSharedCacheEnabled() const { return m_sharedCacheEnabled; }
+    std::string GetSharedCacheName() const { return m_sharedCacheName; }
+    int GetSharedCacheSize() const { return m_sharedCacheSize; }
+    int GetSharedCacheSlotSize() const { return m_sharedCacheSlotSize; }
+    int GetWriteBehindInterval() const { return m_writeBehindInterval; }
+    int GetCoalesceInterval() const { return m_coalesceInterval; }
+    bool IsWriteSpoolEnabled() const { return m_writeSpoolEnabled; }
+    int GetWriteSpoolMaxSize() const { return m_writeSpoolMaxSize; }
+    int GetFlushTimeout() const { return m_flushTimeout; }
+    int GetStallThreshold() const { return m_stallThreshold; }
+    int GetTraceSampleRate() const { return m_traceSampleRate; }
+    bool IsProfilingEnabled() const { return m_profilingEnabled; }
+    int GetSlowQueryThreshold() const { return m_slowQueryThreshold; }
+    bool IsQueryLoggingEnabled() const { return m_logQueries; }
+    size_t GetMaxLogSize() const { return m_maxLogSize; }
+    bool IsLogRotationEnabled() const { return m_logRotation; }
     
     // Set configuration values (for runtime changes)
     void SetAPIServiceURL(const std::string& url) { m_apiServiceURL = url; }
@@ -41,8 +63,11 @@ public:
     void SetTimeout(int timeout) { m_timeout = timeout; }
     void SetRetries(int retries) { m_retries = retries; }
     void SetDebug(bool debug) { m_debug = debug; }
+    void SetCachingEnabled(bool enabled) { m_cachingEnabled = enabled; }
+    void SetCacheTTL(int ttl) { m_cacheTTL = ttl; }
     
-    // Get last error
+    // Get last error; after a successful LoadConfig, a warning about a
+    // setting that was replaced by its default (empty if none)
     std::string GetLastError() const { return m_lastError; }
     
 private:
@@ -57,6 +82,28 @@ private:
     
     int m_maxConnections;
     int m_idleTimeout;
+
+    bool m_cachingEnabled;
+    int m_cacheTTL;
+    int m_batchSize;
+    int m_cacheMaxMemory; // megabytes
+    int m_cacheCollectionQuota; // percent of m_cacheMaxMemory
+    bool m_sharedCacheEnabled;
+    std::string m_sharedCacheName;
+    int m_sharedCacheSize; // megabytes
+    int m_sharedCacheSlotSize; // bytes
+    int m_writeBehindInterval; // milliseconds
+    int m_coalesceInterval; // milliseconds
+    bool m_writeSpoolEnabled;
+    int m_writeSpoolMaxSize; // megabytes
+    int m_flushTimeout; // milliseconds
+    int m_stallThreshold; // microseconds
+    int m_traceSampleRate; // 1 in N requests, 0 = off
+    bool m_profilingEnabled;
+    int m_slowQueryThreshold; // milliseconds
+    bool m_logQueries;
+    size_t m_maxLogSize; // bytes
+    bool m_logRotation;
     
     std::string m_lastError;
 
@@ -66,6 +113,7 @@ private:
     std::string ExtractJSONString(const std::string& section, const std::string& key, const std::string& defaultValue);
     int ExtractJSONInt(const std::string& section, const std::string& key, int defaultValue);
     bool ExtractJSONBool(const std::string& section, const std::string& key, bool defaultValue);
+    static bool ParseSize(const std::string& size, size_t& bytes);
 };
 
 #endif // _CONFIG_MANAGER_H_
@@ -0,0 +1,440 @@
+/**
+ * MongoDB Extension Document Cache Implementation
+ */
+
+#include "document_cache.h"
+#include "json_utils.h"
+#include "shm_cache.h"
+
+// Allocator and node bookkeeping per entry (map node + LRU list node)
+static const size_t ENTRY_OVERHEAD = 96;
+
+// A stale entry whose refresh did not land is refreshed again after this long
+static const int STALE_REFRESH_RETRY_SECONDS = 5;
+
+DocumentCache::DocumentCache()
+    : m_shared(nullptr)
+    , m_clearGeneration(0)
+    , m_generationCounter(0)
+    , m_useCounter(0)
+    , m_totalBytes(0)
+    , m_maxBytes(32 * 1024 * 1024)
+    , m_quotaPercent(50)
+    , m_enabled(true)
+    , m_ttlSeconds(300)
+{
+}
+
+DocumentCache::~DocumentCache()
+{
+}
+
+void DocumentCache::Configure(bool enabled, int ttlSeconds, size_t maxBytes, int quotaPercent)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_enabled = enabled;
+    m_ttlSeconds = ttlSeconds > 0 ? ttlSeconds : 0;
+    m_maxBytes = maxBytes;
+    m_quotaPercent = quotaPercent < 1 ? 1 : (quotaPercent > 100 ? 100 : quotaPercent);
+
+    if (!m_enabled || m_ttlSeconds == 0)
+    {
+        m_clearGeneration = ++m_generationCounter;
+        for (auto& coll : m_collections)
+        {
+            ClearEntriesLocked(coll.second);
+        }
+        return;
+    }
+
+    // Shrink to the new limits right away
+    for (auto& coll : m_collections)
+    {
+        EnforceLimitsLocked(coll.second);
+    }
+}
+
+void DocumentCache::SetCollectionQuota(const std::string& collectionKey, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Collection& coll = m_collections[collectionKey];
+    coll.quota = bytes;
+    EnforceLimitsLocked(coll);
+}
+
+void DocumentCache::SetStaleWhileRevalidate(const std::string& collectionKey, int maxStaleSeconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_collections[collectionKey].maxStaleSeconds = maxStaleSeconds > 0 ? maxStaleSeconds : 0;
+}
+
+void DocumentCache::AttachSharedTier(SharedDocumentCache* shared)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shared = shared;
+}
+
+bool DocumentCache::Get(const std::string& collectionKey, const std::string& filterJson,
+                        std::string& documentJson, bool& found, bool* needsRefresh)
+{
+    if (!m_enabled || m_ttlSeconds == 0)
+        return false;
+
+    std::string key = NormalizeFilter(filterJson);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Collection& coll = m_collections[collectionKey];
+    auto it = coll.entries.find(key);
+    if (it != coll.entries.end())
+    {
+        auto now = std::chrono::steady_clock::now();
+        Entry& entry = it->second;
+        if (now < entry.expires)
+        {
+            TouchLocked(coll, entry);
+            coll.hits++;
+            documentJson = entry.json;
+            found = entry.found;
+            return true;
+        }
+
+        // Past the TTL but within the staleness limit: answer now, refresh behind
+        if (needsRefresh && now < entry.expires + std::chrono::seconds(coll.maxStaleSeconds))
+        {
+            *needsRefresh = now >= entry.refreshAfter;
+            if (*needsRefresh)
+                entry.refreshAfter = now + std::chrono::seconds(STALE_REFRESH_RETRY_SECONDS);
+
+            TouchLocked(coll, entry);
+            coll.hits++;
+            coll.staleHits++;
+            documentJson = entry.json;
+            found = entry.found;
+            return true;
+        }
+        EraseLocked(coll, it);
+    }
+
+    // Another server on this host may already have fetched it
+    if (!m_shared || !m_shared->Get(collectionKey, key, documentJson, found))
+    {
+        coll.misses++;
+        return false;
+    }
+
+    std::string rawId;
+    if (found && JsonGetMember(documentJson, "_id", rawId))
+        rawId = JsonUnquote(rawId);
+
+    coll.hits++;
+    StoreLocked(coll, key, documentJson, rawId, found);
+    return true;
+}
+
+DocumentCache::Generation DocumentCache::GetGeneration(const std::string& collectionKey) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Generation generation;
+    generation.local = GenerationLocked(collectionKey);
+    generation.shared = m_shared ? m_shared->GetGeneration(collectionKey) : 0;
+    return generation;
+}
+
+void DocumentCache::Put(const std::string& collectionKey, const Generation& generation, const std::string& filterJson,
+                        const std::string& documentJson, bool found)
+{
+    if (!m_enabled || m_ttlSeconds == 0)
+        return;
+
+    std::string key = NormalizeFilter(filterJson);
+
+    std::string rawId;
+    if (found && JsonGetMember(documentJson, "_id", rawId))
+        rawId = JsonUnquote(rawId);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (GenerationLocked(collectionKey) != generation.local)
+        return; // invalidated while the request was in flight
+
+    StoreLocked(m_collections[collectionKey], key, documentJson, rawId, found);
+
+    if (m_shared)
+        m_shared->Put(collectionKey, generation.shared, key, documentJson, found, m_ttlSeconds);
+}
+
+bool DocumentCache::Replace(const std::string& collectionKey, const Generation& generation,
+                            const std::vector<std::pair<std::string, std::string>>& documents)
+{
+    if (!m_enabled || m_ttlSeconds == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (GenerationLocked(collectionKey) != generation.local)
+        return false;
+
+    // Entries missing from the new set must not survive, so start a new generation
+    BumpGenerationLocked(collectionKey);
+    Collection& coll = m_collections[collectionKey];
+    ClearEntriesLocked(coll);
+
+    uint32_t sharedGeneration = 0;
+    if (m_shared)
+    {
+        m_shared->InvalidateCollection(collectionKey);
+        sharedGeneration = m_shared->GetGeneration(collectionKey);
+    }
+
+    for (const auto& document : documents)
+    {
+        std::string key = NormalizeFilter(document.first);
+        std::string rawId;
+        if (JsonGetMember(document.second, "_id", rawId))
+            rawId = JsonUnquote(rawId);
+
+        StoreLocked(coll, key, document.second, rawId, true);
+
+        if (m_shared)
+            m_shared->Put(collectionKey, sharedGeneration, key, document.second, true, m_ttlSeconds);
+    }
+    return true;
+}
+
+void DocumentCache::InvalidateCollection(const std::string& collectionKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    BumpGenerationLocked(collectionKey);
+    if (m_shared)
+        m_shared->InvalidateCollection(collectionKey);
+
+    auto coll = m_collections.find(collectionKey);
+    if (coll != m_collections.end())
+        ClearEntriesLocked(coll->second);
+}
+
+void DocumentCache::InvalidateDocument(const std::string& collectionKey, const std::string& documentId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    BumpGenerationLocked(collectionKey);
+    if (m_shared)
+        m_shared->InvalidateCollection(collectionKey);
+    auto coll = m_collections.find(collectionKey);
+    if (coll == m_collections.end())
+        return;
+
+    auto& entries = coll->second.entries;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto current = it++;
+        if (!current->second.found || current->second.id == documentId)
+            EraseLocked(coll->second, current);
+    }
+}
+
+void DocumentCache::InvalidateMissing(const std::string& collectionKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    BumpGenerationLocked(collectionKey);
+    if (m_shared)
+        m_shared->InvalidateCollection(collectionKey);
+    auto coll = m_collections.find(collectionKey);
+    if (coll == m_collections.end())
+        return;
+
+    auto& entries = coll->second.entries;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto current = it++;
+        if (!current->second.found)
+            EraseLocked(coll->second, current);
+    }
+}
+
+void DocumentCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_clearGeneration = ++m_generationCounter;
+    for (auto& coll : m_collections)
+    {
+        ClearEntriesLocked(coll.second);
+    }
+    if (m_shared)
+        m_shared->InvalidateAll();
+}
+
+size_t DocumentCache::GetEntryCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const auto& coll : m_collections)
+    {
+        count += coll.second.entries.size();
+    }
+    return count;
+}
+
+bool DocumentCache::GetStats(const std::string& collectionKey, Stats& stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto coll = m_collections.find(collectionKey);
+    if (coll == m_collections.end())
+        return false;
+
+    stats = StatsLocked(coll->first, coll->second);
+    return true;
+}
+
+DocumentCache::Stats DocumentCache::GetTotals() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats totals = { "", 0, m_totalBytes.load(), m_maxBytes, 0, 0, 0, 0 };
+    for (const auto& coll : m_collections)
+    {
+        totals.entries += coll.second.entries.size();
+        totals.hits += coll.second.hits;
+        totals.staleHits += coll.second.staleHits;
+        totals.misses += coll.second.misses;
+        totals.evictions += coll.second.evictions;
+    }
+    return totals;
+}
+
+std::vector<DocumentCache::Stats> DocumentCache::GetAllStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Stats> stats;
+    stats.reserve(m_collections.size());
+    for (const auto& coll : m_collections)
+    {
+        stats.push_back(StatsLocked(coll.first, coll.second));
+    }
+    return stats;
+}
+
+void DocumentCache::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& coll : m_collections)
+    {
+        coll.second.hits = 0;
+        coll.second.staleHits = 0;
+        coll.second.misses = 0;
+        coll.second.evictions = 0;
+    }
+}
+
+uint64_t DocumentCache::GenerationLocked(const std::string& collectionKey) const
+{
+    auto it = m_generations.find(collectionKey);
+    uint64_t generation = it != m_generations.end() ? it->second : 0;
+    return generation > m_clearGeneration ? generation : m_clearGeneration;
+}
+
+void DocumentCache::BumpGenerationLocked(const std::string& collectionKey)
+{
+    m_generations[collectionKey] = ++m_generationCounter;
+}
+
+void DocumentCache::StoreLocked(Collection& coll, const std::string& key, const std::string& documentJson,
+                                const std::string& documentId, bool found)
+{
+    auto it = coll.entries.find(key);
+    if (it == coll.entries.end())
+    {
+        it = coll.entries.insert(std::make_pair(key, Entry())).first;
+        coll.lru.push_front(key);
+        it->second.lru = coll.lru.begin();
+        it->second.bytes = 0;
+    }
+
+    Entry& entry = it->second;
+    entry.json = found ? documentJson : std::string();
+    entry.id = documentId;
+    entry.found = found;
+    entry.expires = std::chrono::steady_clock::now() + std::chrono::seconds(m_ttlSeconds);
+    entry.refreshAfter = entry.expires;
+
+    // The filter is held twice: as the map key and in the LRU list
+    size_t bytes = sizeof(Entry) + ENTRY_OVERHEAD + key.length() * 2 + entry.json.length() + entry.id.length();
+    coll.bytes += bytes - entry.bytes;
+    m_totalBytes += bytes - entry.bytes;
+    entry.bytes = bytes;
+
+    TouchLocked(coll, entry);
+    EnforceLimitsLocked(coll);
+}
+
+void DocumentCache::TouchLocked(Collection& coll, Entry& entry)
+{
+    entry.lastUse = ++m_useCounter;
+    coll.lru.splice(coll.lru.begin(), coll.lru, entry.lru);
+}
+
+void DocumentCache::EraseLocked(Collection& coll, std::map<std::string, Entry>::iterator it)
+{
+    coll.bytes -= it->second.bytes;
+    m_totalBytes -= it->second.bytes;
+    coll.lru.erase(it->second.lru);
+    coll.entries.erase(it);
+}
+
+void DocumentCache::ClearEntriesLocked(Collection& coll)
+{
+    m_totalBytes -= coll.bytes;
+    coll.bytes = 0;
+    coll.entries.clear();
+    coll.lru.clear();
+}
+
+void DocumentCache::EnforceLimitsLocked(Collection& coll)
+{
+    // Collection quota first, evicting from the collection's own LRU tail
+    size_t quota = QuotaLocked(coll);
+    while (coll.bytes > quota && !coll.lru.empty())
+    {
+        EraseLocked(coll, coll.entries.find(coll.lru.back()));
+        coll.evictions++;
+    }
+
+    // Then the global budget, evicting the least recently used entry of any collection
+    while (m_totalBytes > m_maxBytes)
+    {
+        Collection* oldest = nullptr;
+        uint64_t oldestUse = 0;
+        for (auto& other : m_collections)
+        {
+            if (other.second.lru.empty())
+                continue;
+
+            uint64_t lastUse = other.second.entries.find(other.second.lru.back())->second.lastUse;
+            if (!oldest || lastUse < oldestUse)
+            {
+                oldest = &other.second;
+                oldestUse = lastUse;
+            }
+        }
+        if (!oldest)
+            break;
+
+        EraseLocked(*oldest, oldest->entries.find(oldest->lru.back()));
+        oldest->evictions++;
+    }
+}
+
+size_t DocumentCache::QuotaLocked(const Collection& coll) const
+{
+    if (coll.quota > 0)
+        return coll.quota;
+    return m_maxBytes / 100 * m_quotaPercent;
+}
+
+DocumentCache::Stats DocumentCache::StatsLocked(const std::string& collectionKey, const Collection& coll) const
+{
+    Stats stats = { collectionKey, coll.entries.size(), coll.bytes, QuotaLocked(coll),
+                    coll.hits, coll.staleHits, coll.misses, coll.evictions };
+    return stats;
+}
+
+std::string DocumentCache::NormalizeFilter(const std::string& filterJson)
+{
+    return JsonCompact(filterJson);
+}
@@ -0,0 +1,172 @@
+/**
+ * MongoDB Extension Document Cache
+ * Short-lived read cache for single-document lookups (FindOne), bounded by a
+ * byte budget with per-collection quotas and LRU eviction
+ */
+
+#ifndef _DOCUMENT_CACHE_H_
+#define _DOCUMENT_CACHE_H_
+
+#include <string>
+#include <map>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+class SharedDocumentCache;
+
+class DocumentCache
+{
+public:
+    // Invalidation generations of both tiers, taken before a request
+    struct Generation
+    {
+        uint64_t local;
+        uint32_t shared;
+    };
+
+    // Counters for one collection, or for the whole cache
+    struct Stats
+    {
+        std::string collectionKey;
+        size_t entries;
+        size_t bytes;
+        size_t quota; // byte limit that applies to the collection (the budget for totals)
+        uint64_t hits;
+        uint64_t staleHits; // hits served past their TTL (stale-while-revalidate)
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+    DocumentCache();
+    ~DocumentCache();
+
+    // Apply settings from the "performance" config section. maxBytes is the
+    // budget for all entries; each collection may use quotaPercent of it.
+    void Configure(bool enabled, int ttlSeconds, size_t maxBytes, int quotaPercent);
+    bool IsEnabled() const { return m_enabled; }
+    int GetTTL() const { return m_ttlSeconds; }
+    size_t GetMaxBytes() const { return m_maxBytes; }
+
+    // Give one collection its own byte quota; 0 restores the default percentage
+    void SetCollectionQuota(const std::string& collectionKey, size_t bytes);
+
+    // Stale-while-revalidate for one collection: expired entries are still
+    // served for up to maxStaleSeconds while a refresh runs; 0 turns it off
+    void SetStaleWhileRevalidate(const std::string& collectionKey, int maxStaleSeconds);
+
+    // Optional host-wide second tier, consulted on local misses. Pass nullptr
+    // to detach it; the segment itself is owned by the caller.
+    void AttachSharedTier(SharedDocumentCache* shared);
+    bool HasSharedTier() const { return m_shared != nullptr; }
+
+    // Look up a cached result. Returns false on miss or expiry.
+    // found is false for a cached "no such document" result.
+    // Callers that can refresh in the background pass needsRefresh; they may
+    // then get an expired entry of a stale-while-revalidate collection, with
+    // needsRefresh set for the one caller that should issue the refresh.
+    bool Get(const std::string& collectionKey, const std::string& filterJson,
+             std::string& documentJson, bool& found, bool* needsRefresh = nullptr);
+
+    // Current invalidation generation of a collection. Read it before sending
+    // a request and pass it to Put so that a result racing with an
+    // invalidation (e.g. from a change stream) is not cached.
+    Generation GetGeneration(const std::string& collectionKey) const;
+
+    // Store a result; pass found = false to remember that no document matched
+    void Put(const std::string& collectionKey, const Generation& generation, const std::string& filterJson,
+             const std::string& documentJson, bool found = true);
+
+    // Replace every entry of a collection with a complete (filter, document)
+    // set, e.g. a refreshed snapshot. Returns false and changes nothing if the
+    // collection was invalidated after the generation was taken.
+    bool Replace(const std::string& collectionKey, const Generation& generation,
+                 const std::vector<std::pair<std::string, std::string>>& documents);
+
+    // Invalidations also bump the collection's generation in the shared tier,
+    // which drops its entries for every instance on the host
+
+    // Drop every entry for one collection (called after writes)
+    void InvalidateCollection(const std::string& collectionKey);
+
+    // Drop the entries holding the document with this _id, and every
+    // "not found" entry since the change may make one of them match
+    void InvalidateDocument(const std::string& collectionKey, const std::string& documentId);
+
+    // Drop only the "not found" entries (a document was inserted elsewhere)
+    void InvalidateMissing(const std::string& collectionKey);
+    void Clear();
+
+    size_t GetEntryCount() const;
+
+    // Bytes of all entries; a running total, so reading it does not lock the cache
+    size_t GetMemoryUsage() const { return m_totalBytes; }
+
+    // Counters survive invalidation; ResetStats zeroes them
+    bool GetStats(const std::string& collectionKey, Stats& stats) const;
+    Stats GetTotals() const;
+    std::vector<Stats> GetAllStats() const;
+    void ResetStats();
+
+    // Canonical form of a filter so that whitespace does not matter
+    static std::string NormalizeFilter(const std::string& filterJson);
+
+private:
+    struct Entry
+    {
+        std::string json;
+        std::string id; // document _id, used by change stream invalidation
+        bool found;
+        std::chrono::steady_clock::time_point expires;
+        size_t bytes;
+        uint64_t lastUse;
+        std::chrono::steady_clock::time_point refreshAfter; // earliest next refresh of a stale entry
+        std::list<std::string>::iterator lru;
+    };
+
+    struct Collection
+    {
+        Collection() : bytes(0), quota(0), maxStaleSeconds(0), hits(0), staleHits(0), misses(0), evictions(0) {}
+
+        std::map<std::string, Entry> entries; // filter -> entry
+        std::list<std::string> lru;           // filters, most recently used first
+        size_t bytes;
+        size_t quota; // 0 = quotaPercent of the budget
+        int maxStaleSeconds;
+        uint64_t hits;
+        uint64_t staleHits;
+        uint64_t misses;
+        uint64_t evictions;
+    };
+
+    uint64_t GenerationLocked(const std::string& collectionKey) const;
+    void BumpGenerationLocked(const std::string& collectionKey);
+
+    void StoreLocked(Collection& coll, const std::string& key, const std::string& documentJson,
+                     const std::string& documentId, bool found);
+    void TouchLocked(Collection& coll, Entry& entry);
+    void EraseLocked(Collection& coll, std::map<std::string, Entry>::iterator it);
+    void ClearEntriesLocked(Collection& coll);
+    void EnforceLimitsLocked(Collection& coll);
+    size_t QuotaLocked(const Collection& coll) const;
+    Stats StatsLocked(const std::string& collectionKey, const Collection& coll) const;
+
+    mutable std::mutex m_mutex;
+    SharedDocumentCache* m_shared;
+    std::map<std::string, Collection> m_collections; // collection key -> entries and counters
+    std::map<std::string, uint64_t> m_generations;
+    uint64_t m_clearGeneration;
+    uint64_t m_generationCounter;
+    uint64_t m_useCounter;
+    std::atomic<size_t> m_totalBytes; // changed under m_mutex, see GetMemoryUsage
+    size_t m_maxBytes;
+    int m_quotaPercent;
+    std::atomic<bool> m_enabled;    // set under m_mutex, read without it by Get and Put
+    std::atomic<int> m_ttlSeconds;  // likewise
+};
+
+#endif // _DOCUMENT_CACHE_H_
@@ -0,0 +1,577 @@
+/**
+ * MongoDB Extension Event Streams Implementation
+ */
+
+#include "event_stream.h"
+#include "document_cache.h"
+#include "write_spool.h"
+#include "http_transport.h"
+#include "json_utils.h"
+#include "request_trace.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Events a stream may buffer before Push refuses more
+static const size_t EVENT_MAX_PENDING = 1000000;
+
+// Events per insertMany request when the plugin does not choose
+static const size_t EVENT_DEFAULT_BATCH_SIZE = 1000;
+static const size_t EVENT_MAX_BATCH_SIZE = 50000;
+
+EventStreams::EventStreams(DocumentCache& cache)
+    : m_cache(cache)
+    , m_spool(nullptr)
+    , m_sending(false)
+    , m_stop(false)
+    , m_cancel(false)
+    , m_unknown(0)
+    , m_bytes(0)
+{
+}
+
+EventStreams::~EventStreams()
+{
+    Stop(std::chrono::steady_clock::now());
+}
+
+bool EventStreams::ParseSchema(const std::string& schema, std::vector<Field>& fields, std::string& error)
+{
+    fields.clear();
+    size_t pos = 0;
+    while (pos <= schema.size())
+    {
+        size_t end = schema.find(',', pos);
+        if (end == std::string::npos)
+            end = schema.size();
+
+        std::string entry = schema.substr(pos, end - pos);
+        size_t colon = entry.find(':');
+        if (colon == std::string::npos || colon == 0)
+        {
+            error = "field \"" + entry + "\" is not name:type";
+            return false;
+        }
+
+        Field field;
+        field.name = entry.substr(0, colon);
+        std::string type = entry.substr(colon + 1);
+        if (type == "int")
+            field.type = Field_Int;
+        else if (type == "float")
+            field.type = Field_Float;
+        else if (type == "bool")
+            field.type = Field_Bool;
+        else
+        {
+            error = "field \"" + field.name + "\" has unknown type \"" + type + "\" (int, float or bool)";
+            return false;
+        }
+
+        if (field.name == EVENT_TIME_FIELD || field.name == EVENT_META_FIELD || field.name[0] == '$' ||
+            field.name.find_first_of("\".\\") != std::string::npos)
+        {
+            error = "field name \"" + field.name + "\" is not allowed";
+            return false;
+        }
+
+        fields.push_back(field);
+        pos = end + 1;
+    }
+
+    if (fields.empty())
+    {
+        error = "schema has no fields";
+        return false;
+    }
+    return true;
+}
+
+uint32_t EventStreams::Open(const Target& target, const std::vector<Field>& fields, const std::string& metaJson,
+                            size_t batchSize, int flushIntervalMs)
+{
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->target = target;
+    stream->fields = fields;
+    stream->metaJson = metaJson;
+    stream->batchSize = batchSize == 0 ? EVENT_DEFAULT_BATCH_SIZE :
+                        (batchSize > EVENT_MAX_BATCH_SIZE ? EVENT_MAX_BATCH_SIZE : batchSize);
+    stream->intervalMs = flushIntervalMs > 0 ? flushIntervalMs : 1;
+
+    for (const Field& field : fields)
+        stream->prefixes.push_back(",\"" + field.name + "\":");
+
+    // Room for a full batch, so Push does not reallocate in the common case
+    for (Columns* columns : { &stream->columns, &stream->spare })
+    {
+        columns->times.reserve(stream->batchSize);
+        columns->values.resize(fields.size());
+        for (std::vector<int32_t>& column : columns->values)
+            column.reserve(stream->batchSize);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop)
+        return 0;
+
+    UpdateBytesLocked(*stream);
+    m_streams.push_back(std::move(stream));
+    if (!m_thread.joinable())
+        m_thread = std::thread(&EventStreams::Run, this);
+    return (uint32_t)m_streams.size();
+}
+
+bool EventStreams::Push(uint32_t id, const int32_t* values, int64_t timestampMs)
+{
+    if (id == 0 || id > m_streams.size())
+        return false;
+
+    Stream& stream = *m_streams[id - 1];
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(stream.mutex);
+        Columns& columns = stream.columns;
+        if (stream.closed)
+            return false;
+
+        if (columns.times.size() >= EVENT_MAX_PENDING)
+        {
+            stream.dropped++;
+            return false;
+        }
+
+        if (columns.times.empty())
+            stream.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(stream.intervalMs);
+
+        size_t capacity = columns.times.capacity();
+        columns.times.push_back(timestampMs);
+        for (size_t i = 0; i < columns.values.size(); i++)
+            columns.values[i].push_back(values[i]);
+        stream.pushed++;
+
+        // The columns grow together; recount only when they reallocated
+        if (columns.times.capacity() != capacity)
+            UpdateBytesLocked(stream);
+
+        // The thread sleeps until the earliest deadline; only a full batch
+        // or a new deadline needs to wake it early
+        wake = columns.times.size() == 1 || columns.times.size() == stream.batchSize;
+    }
+
+    if (wake)
+        m_wake.notify_one();
+    return true;
+}
+
+size_t EventStreams::GetFieldCount(uint32_t id) const
+{
+    if (id == 0 || id > m_streams.size())
+        return 0;
+    return m_streams[id - 1]->fields.size();
+}
+
+void EventStreams::Flush(uint32_t id)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_streams.size(); i++)
+        {
+            if (id != 0 && i != id - 1)
+                continue;
+
+            Stream& stream = *m_streams[i];
+            std::lock_guard<std::mutex> streamLock(stream.mutex);
+            if (!stream.columns.times.empty())
+                stream.flushNow = true;
+        }
+    }
+    m_wake.notify_one();
+}
+
+void EventStreams::Close(uint32_t id)
+{
+    if (id == 0 || id > m_streams.size())
+        return;
+
+    {
+        Stream& stream = *m_streams[id - 1];
+        std::lock_guard<std::mutex> lock(stream.mutex);
+        stream.closed = true;
+        stream.flushNow = !stream.columns.times.empty();
+    }
+    m_wake.notify_one();
+}
+
+size_t EventStreams::Drain(std::chrono::steady_clock::time_point deadline)
+{
+    Flush(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait_until(lock, deadline, [this]() { return !m_sending && PendingLocked() == 0; });
+
+    // Out of time: journal the rest instead of waiting for it
+    WriteSpool* spool = m_spool;
+    if ((m_sending || PendingLocked() > 0) && spool && spool->IsOpen())
+    {
+        m_cancel = true;
+        m_idle.wait(lock, [this]() { return !m_sending; });
+        SpoolDueLocked(lock);
+        m_cancel = false;
+        m_wake.notify_one();
+    }
+
+    return PendingLocked();
+}
+
+size_t EventStreams::Stop(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_wake.notify_all();
+    m_idle.wait_until(lock, deadline, [this]() { return !m_sending && PendingLocked() == 0; });
+
+    // Out of time: abort what is running; the thread takes no more events
+    m_cancel = true;
+    m_idle.wait(lock, [this]() { return !m_sending; });
+    if (m_thread.joinable())
+    {
+        lock.unlock();
+        m_wake.notify_all();
+        m_thread.join();
+        lock.lock();
+    }
+
+    WriteSpool* spool = m_spool;
+    if (spool && spool->IsOpen())
+        SpoolDueLocked(lock);
+
+    size_t dropped = 0;
+    for (auto& entry : m_streams)
+    {
+        Stream& stream = *entry;
+        std::lock_guard<std::mutex> streamLock(stream.mutex);
+        size_t pending = stream.columns.times.size();
+        dropped += pending;
+        stream.failed += pending;
+        stream.columns = Columns();
+        UpdateBytesLocked(stream);
+    }
+    if (dropped > 0)
+        m_lastError = "unloading, dropped " + std::to_string(dropped) + " buffered events";
+    return dropped;
+}
+
+static EventStreams::Stats MakeStats(const std::string& key, size_t pending, uint64_t pushed, uint64_t written,
+                                     uint64_t dropped, uint64_t failed, uint64_t requests)
+{
+    EventStreams::Stats stats = { key, pending, pushed, written, dropped, failed, requests };
+    return stats;
+}
+
+bool EventStreams::GetStats(uint32_t id, Stats& stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id == 0 || id > m_streams.size())
+        return false;
+
+    const Stream& stream = *m_streams[id - 1];
+    std::lock_guard<std::mutex> streamLock(stream.mutex);
+    stats = MakeStats(stream.target.collectionKey, stream.columns.times.size(), stream.pushed, stream.written,
+                      stream.dropped, stream.failed, stream.requests);
+    return true;
+}
+
+EventStreams::Stats EventStreams::GetTotals() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats totals = MakeStats("", 0, 0, 0, 0, 0, 0);
+    for (const auto& stream : m_streams)
+    {
+        std::lock_guard<std::mutex> streamLock(stream->mutex);
+        totals.pending += stream->columns.times.size();
+        totals.pushed += stream->pushed;
+        totals.written += stream->written;
+        totals.dropped += stream->dropped;
+        totals.failed += stream->failed;
+        totals.requests += stream->requests;
+    }
+    return totals;
+}
+
+std::vector<EventStreams::Stats> EventStreams::GetAllStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Stats> result;
+    for (const auto& stream : m_streams)
+    {
+        std::lock_guard<std::mutex> streamLock(stream->mutex);
+        if (stream->closed && stream->columns.times.empty())
+            continue;
+        result.push_back(MakeStats(stream->target.collectionKey, stream->columns.times.size(), stream->pushed,
+                                   stream->written, stream->dropped, stream->failed, stream->requests));
+    }
+    return result;
+}
+
+size_t EventStreams::GetMemoryUsage(uint32_t id) const
+{
+    if (id == 0)
+        return m_bytes;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return id <= m_streams.size() ? m_streams[id - 1]->bytes.load() : 0;
+}
+
+std::string EventStreams::GetLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+size_t EventStreams::PendingLocked() const
+{
+    size_t pending = 0;
+    for (const auto& stream : m_streams)
+    {
+        std::lock_guard<std::mutex> streamLock(stream->mutex);
+        pending += stream->columns.times.size();
+    }
+    return pending;
+}
+
+// Recount a stream's heap bytes after its buffers grew or were swapped and
+// apply the difference to the total; called with stream.mutex held
+void EventStreams::UpdateBytesLocked(Stream& stream)
+{
+    size_t bytes = sizeof(Stream) + stream.metaJson.capacity();
+    for (const Columns* columns : { &stream.columns, &stream.spare })
+    {
+        bytes += columns->times.capacity() * sizeof(int64_t);
+        for (const auto& values : columns->values)
+            bytes += values.capacity() * sizeof(int32_t);
+    }
+    m_bytes += bytes - stream.bytes;
+    stream.bytes = bytes;
+}
+
+// Take all buffered events of the first due stream; called with m_mutex held
+bool EventStreams::TakeDue(std::chrono::steady_clock::time_point now, Stream*& taken, Columns& columns)
+{
+    for (auto& entry : m_streams)
+    {
+        Stream& stream = *entry;
+        std::lock_guard<std::mutex> lock(stream.mutex);
+        size_t size = stream.columns.times.size();
+        if (size == 0 || !(m_stop || stream.flushNow || now >= stream.deadline || size >= stream.batchSize))
+            continue;
+
+        // Push continues into the spare columns
+        columns = std::move(stream.columns);
+        stream.columns = std::move(stream.spare);
+        stream.columns.times.clear();
+        stream.columns.values.resize(stream.fields.size());
+        for (std::vector<int32_t>& column : stream.columns.values)
+            column.clear();
+        UpdateBytesLocked(stream);
+
+        stream.flushNow = false;
+        taken = &stream;
+        return true;
+    }
+    return false;
+}
+
+// Shortest text that reads back as the same float
+static void AppendFloat(std::string& out, int32_t cell)
+{
+    float value;
+    memcpy(&value, &cell, sizeof(value));
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.7g", value);
+    if (strtof(buffer, nullptr) != value)
+        snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out += buffer;
+}
+
+std::string EventStreams::Encode(const Stream& stream, const Columns& columns, size_t first, size_t count) const
+{
+    std::string body = "{\"documents\":[";
+    body.reserve(64 + count * (48 + stream.metaJson.size() + stream.fields.size() * 24));
+
+    std::string timePrefix = std::string("{\"") + EVENT_TIME_FIELD + "\":";
+    std::string metaMember = stream.metaJson.empty() ? "" :
+                             std::string(",\"") + EVENT_META_FIELD + "\":" + stream.metaJson;
+
+    for (size_t row = first; row < first + count; row++)
+    {
+        if (row > first)
+            body += ",";
+        body += timePrefix;
+        body += std::to_string(columns.times[row]);
+        body += metaMember;
+
+        for (size_t i = 0; i < stream.fields.size(); i++)
+        {
+            int32_t cell = columns.values[i][row];
+            body += stream.prefixes[i];
+            switch (stream.fields[i].type)
+            {
+                case Field_Int:   body += std::to_string(cell); break;
+                case Field_Float: AppendFloat(body, cell); break;
+                case Field_Bool:  body += cell != 0 ? "true" : "false"; break;
+            }
+        }
+        body += "}";
+    }
+
+    // Unordered, so one rejected event does not hold back the rest
+    body += std::string("],\"options\":{\"ordered\":false},\"timeField\":\"") + EVENT_TIME_FIELD + "\"}";
+    return body;
+}
+
+void EventStreams::Send(Stream& stream, Columns& columns, bool spoolOnly)
+{
+    WriteSpool* spool = m_spool;
+    size_t total = columns.times.size();
+
+    for (size_t first = 0; first < total; first += stream.batchSize)
+    {
+        size_t count = total - first < stream.batchSize ? total - first : stream.batchSize;
+        RequestTraceScope trace("event stream");
+        std::string postData = Encode(stream, columns, first, count);
+
+        // While the spool drains, new writes queue up behind the journaled ones
+        bool spooled = false, success = false, sent = false, aborted = false;
+        uint64_t written = 0;
+        if (spoolOnly || (spool && spool->IsDeferring()))
+        {
+            spooled = spool && spool->Append(stream.target.insertManyUrl, stream.target.mongoUri, postData);
+        }
+        else
+        {
+            std::string response, data, insertedCount, successValue;
+            long statusCode;
+            sent = true;
+            bool transferred = HttpServicePost(stream.target.insertManyUrl, postData, stream.target.apiKey,
+                                               response, statusCode, &m_cancel);
+            success = transferred && statusCode < 400 && JsonGetMember(response, "success", successValue) &&
+                      successValue == "true" && JsonGetMember(response, "data", data);
+
+            // Keep the batch for later if the service or database is down; never
+            // one that was aborted after sending (see GetUnknownOutcomes)
+            aborted = statusCode == HTTP_STATUS_ABORTED;
+            spooled = !success && spool && HttpServiceUnavailable(transferred, statusCode, response) &&
+                      spool->Append(stream.target.insertManyUrl, stream.target.mongoUri, postData);
+
+            if (success && JsonGetMember(data, "insertedCount", insertedCount))
+                written = strtoull(insertedCount.c_str(), nullptr, 10);
+            else if (success)
+                written = count;
+        }
+
+        if (written > 0 || aborted)
+            m_cache.InvalidateCollection(stream.target.collectionKey);
+
+        {
+            std::lock_guard<std::mutex> lock(stream.mutex);
+            stream.written += written;
+            stream.requests += sent ? 1 : 0;
+            if (!success && !spooled)
+                stream.failed += count;
+        }
+
+        if (!success && !spooled)
+        {
+            if (aborted)
+                m_unknown += count;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_lastError = "insertMany of " + std::to_string(count) + " events " +
+                          (aborted ? "aborted, outcome unknown: " : "failed: ") +
+                          stream.target.insertManyUrl.substr(stream.target.insertManyUrl.find("/databases/") + 11);
+        }
+    }
+
+    // Hand the columns back so their capacity is reused
+    std::lock_guard<std::mutex> lock(stream.mutex);
+    if (stream.closed)
+    {
+        if (stream.columns.times.empty())
+            stream.columns = Columns();
+        stream.spare = Columns();
+    }
+    else
+    {
+        stream.spare = std::move(columns);
+    }
+    UpdateBytesLocked(stream);
+}
+
+// Journal every buffered event without sending it; called with m_mutex held
+void EventStreams::SpoolDueLocked(std::unique_lock<std::mutex>& lock)
+{
+    Stream* stream;
+    Columns columns;
+    while (TakeDue(std::chrono::steady_clock::now(), stream, columns))
+    {
+        lock.unlock();
+        Send(*stream, columns, true);
+        lock.lock();
+    }
+}
+
+void EventStreams::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        Stream* stream;
+        Columns columns;
+        if (!m_cancel && TakeDue(now, stream, columns))
+        {
+            m_sending = true;
+            lock.unlock();
+            Send(*stream, columns, false);
+            lock.lock();
+            m_sending = false;
+            m_idle.notify_all();
+            continue;
+        }
+
+        if (m_stop)
+            return;
+
+        // Drain is journaling the buffers; wait until it is done
+        if (m_cancel)
+        {
+            m_wake.wait(lock, [this]() { return !m_cancel || m_stop; });
+            continue;
+        }
+
+        // Sleep until the earliest deadline, or until Push/Flush wakes us
+        bool pending = false;
+        auto wakeAt = now + std::chrono::hours(1);
+        for (const auto& entry : m_streams)
+        {
+            std::lock_guard<std::mutex> streamLock(entry->mutex);
+            if (!entry->columns.times.empty() && entry->deadline < wakeAt)
+            {
+                wakeAt = entry->deadline;
+                pending = true;
+            }
+        }
+
+        if (pending)
+            m_wake.wait_until(lock, wakeAt);
+        else
+            m_wake.wait(lock);
+    }
+}
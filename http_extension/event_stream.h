@@ -0,0 +1,173 @@
+/**
+ * MongoDB Extension Event Streams
+ * High-rate telemetry ingestion: a plugin declares a schema once and pushes
+ * events as packed cells. Events are buffered per field and encoded into
+ * insertMany requests by a background thread.
+ */
+
+#ifndef _EVENT_STREAM_H_
+#define _EVENT_STREAM_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class DocumentCache;
+class WriteSpool;
+
+// Fields every event document gets besides its schema fields
+const char* const EVENT_TIME_FIELD = "timestamp"; // milliseconds since the epoch, stored as a date
+const char* const EVENT_META_FIELD = "meta";      // the stream's metadata object, if any
+
+class EventStreams
+{
+public:
+    enum FieldType { Field_Int, Field_Float, Field_Bool };
+
+    struct Field
+    {
+        std::string name;
+        FieldType type;
+    };
+
+    // Where a stream's batches go; built on the game thread
+    struct Target
+    {
+        std::string collectionKey; // document cache key of the collection
+        std::string insertManyUrl;
+        std::string apiKey;
+        std::string mongoUri;      // lets the write spool reopen the connection
+    };
+
+    struct Stats
+    {
+        std::string collectionKey;
+        size_t pending;     // events waiting to be encoded
+        uint64_t pushed;    // events accepted
+        uint64_t written;   // events the service confirmed
+        uint64_t dropped;   // events refused because the buffer was full
+        uint64_t failed;    // events of batches that failed
+        uint64_t requests;  // insertMany requests sent
+    };
+
+    explicit EventStreams(DocumentCache& cache);
+    ~EventStreams();
+
+    // Journal requests the API service could not take instead of dropping them
+    void SetSpool(WriteSpool* spool) { m_spool = spool; }
+
+    // Parse a schema such as "x:float,y:float,damage:int,headshot:bool"
+    static bool ParseSchema(const std::string& schema, std::vector<Field>& fields, std::string& error);
+
+    // Open a stream; metaJson (compact JSON object or empty) is stored in every
+    // event. Returns the stream id, or 0 once the extension is unloading.
+    uint32_t Open(const Target& target, const std::vector<Field>& fields, const std::string& metaJson,
+                  size_t batchSize, int flushIntervalMs);
+
+    // Buffer one event: one cell per schema field, in schema order.
+    // Game thread only, like Open and Close. Returns false if the stream is
+    // closed or its buffer is full.
+    bool Push(uint32_t stream, const int32_t* values, int64_t timestampMs);
+
+    size_t GetFieldCount(uint32_t stream) const;
+
+    // Send the events of one stream, or of all with 0, now
+    void Flush(uint32_t stream);
+
+    // Send what the stream holds and free it
+    void Close(uint32_t stream);
+
+    // Send everything buffered until the deadline, then journal what is left
+    // to the write spool if it is open; otherwise the background thread keeps
+    // sending it. Never waits past the deadline. Returns the number of events
+    // still pending.
+    size_t Drain(std::chrono::steady_clock::time_point deadline);
+
+    // Send what is left until the deadline, then abort the request still
+    // running, journal the rest if the write spool is open and stop the
+    // thread (extension unload). Returns the number of events dropped.
+    size_t Stop(std::chrono::steady_clock::time_point deadline);
+
+    bool GetStats(uint32_t stream, Stats& stats) const;
+    Stats GetTotals() const;
+    std::vector<Stats> GetAllStats() const;
+
+    // Approximate heap bytes of one stream's buffers, or of all with 0.
+    // Buffers keep their capacity after a batch is taken. Kept as running
+    // totals, updated when a buffer grows or is swapped, so reading them
+    // does not lock the streams.
+    size_t GetMemoryUsage(uint32_t stream) const;
+
+    // Events whose request broke off after it was sent: Drain or Stop aborted
+    // it, or it timed out. They may or may not have been applied, so they are
+    // counted as failed rather than spooled, which could write them twice.
+    uint64_t GetUnknownOutcomes() const { return m_unknown; }
+
+    std::string GetLastError() const;
+
+private:
+    // Buffered events, one vector per field
+    struct Columns
+    {
+        std::vector<int64_t> times;
+        std::vector<std::vector<int32_t>> values;
+    };
+
+    struct Stream
+    {
+        Stream() : batchSize(0), intervalMs(0), bytes(0), flushNow(false), closed(false),
+                   pushed(0), written(0), dropped(0), failed(0), requests(0) {}
+
+        Target target;
+        std::vector<Field> fields;
+        std::vector<std::string> prefixes; // ,"name": per field
+        std::string metaJson;
+        size_t batchSize;
+        int intervalMs;
+
+        // Push only contends with the thread taking the columns
+        mutable std::mutex mutex;
+        Columns columns;
+        Columns spare;  // taken columns handed back, keeps their capacity
+        std::atomic<size_t> bytes; // see UpdateBytesLocked
+        std::chrono::steady_clock::time_point deadline; // first buffered event + interval
+        bool flushNow;
+        bool closed;
+        uint64_t pushed;
+        uint64_t written;
+        uint64_t dropped;
+        uint64_t failed;
+        uint64_t requests;
+    };
+
+    void UpdateBytesLocked(Stream& stream);
+    bool TakeDue(std::chrono::steady_clock::time_point now, Stream*& stream, Columns& columns);
+    std::string Encode(const Stream& stream, const Columns& columns, size_t first, size_t count) const;
+    void Send(Stream& stream, Columns& columns, bool spoolOnly);
+    size_t PendingLocked() const;
+    void SpoolDueLocked(std::unique_lock<std::mutex>& lock);
+    void Run();
+
+    DocumentCache& m_cache;
+    std::atomic<WriteSpool*> m_spool;
+
+    mutable std::mutex m_mutex;                   // guards m_streams changes, m_sending and m_lastError
+    std::vector<std::unique_ptr<Stream>> m_streams; // index = id - 1, never shrinks
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;               // a batch finished sending
+    bool m_sending;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_cancel;                   // aborts the request in progress (Drain deadline)
+    std::atomic<uint64_t> m_unknown;              // see GetUnknownOutcomes
+    std::atomic<size_t> m_bytes;                  // all streams, see GetMemoryUsage
+    std::thread m_thread;
+    std::string m_lastError;
+};
+
+#endif // _EVENT_STREAM_H_
@@ -0,0 +1,51 @@
+/**
+ * MongoDB Extension File Utilities Implementation
+ */
+
+#include "file_utils.h"
+#include <cstdio>
+#include <fstream>
+
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+uint64_t Fnv1a(const void* data, size_t length, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool CreateDirectories(const std::string& path)
+{
+    for (size_t pos = 1; pos <= path.length(); pos++)
+    {
+        if (pos != path.length() && path[pos] != '/' && path[pos] != '\\')
+            continue;
+
+        std::string part = path.substr(0, pos);
+#ifdef WIN32
+        _mkdir(part.c_str());
+#else
+        mkdir(part.c_str(), 0755);
+#endif
+    }
+
+#ifdef WIN32
+    std::ofstream probe(path + "/.probe");
+    bool exists = probe.is_open();
+    probe.close();
+    remove((path + "/.probe").c_str());
+    return exists;
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
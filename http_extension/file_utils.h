@@ -0,0 +1,23 @@
+/**
+ * MongoDB Extension File Utilities
+ * Helpers shared by the modules that keep files on disk or in shared memory
+ */
+
+#ifndef _FILE_UTILS_H_
+#define _FILE_UTILS_H_
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+
+// 64-bit FNV-1a of a byte range, stable across processes and restarts. Pass
+// the result of a previous call as hash to continue over another range.
+uint64_t Fnv1a(const void* data, size_t length, uint64_t hash = FNV1A_OFFSET_BASIS);
+
+// Create a directory and any missing parents ('/' or '\\' separated).
+// Returns true if the directory exists afterwards.
+bool CreateDirectories(const std::string& path);
+
+#endif // _FILE_UTILS_H_
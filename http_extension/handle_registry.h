@@ -0,0 +1,90 @@
+/**
+ * MongoDB Extension Handle Registry
+ * Slab-allocated records behind the extension's connection and collection
+ * handles, looked up by id with one index computation
+ */
+
+#ifndef _HANDLE_REGISTRY_H_
+#define _HANDLE_REGISTRY_H_
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Records live in fixed-size slabs that are never moved, so a pointer to a
+// record stays valid until the record is removed. Ids are slot + 1, 0 is never
+// used; freed slots are handed out again, most recently freed first.
+// Not thread-safe: the extension only uses it on the game thread.
+template <typename T, size_t SlabSize = 64>
+class HandleRegistry
+{
+public:
+    HandleRegistry() : m_count(0) {}
+
+    // Id of a new, default-constructed record
+    uint32_t Add()
+    {
+        uint32_t slot;
+        if (!m_free.empty())
+        {
+            slot = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            slot = (uint32_t)m_used.size();
+            if (slot % SlabSize == 0)
+                m_slabs.emplace_back(new T[SlabSize]);
+            m_used.push_back(0);
+        }
+        m_used[slot] = 1;
+        m_count++;
+        return slot + 1;
+    }
+
+    // Record of an id, or nullptr if the id is not in use
+    T* Get(uint32_t id)
+    {
+        if (id == 0 || id > m_used.size() || !m_used[id - 1])
+            return nullptr;
+        return &m_slabs[(id - 1) / SlabSize][(id - 1) % SlabSize];
+    }
+
+    // Free a record; its slot is reset so it holds no memory until reused
+    bool Remove(uint32_t id)
+    {
+        T* record = Get(id);
+        if (!record)
+            return false;
+        *record = T();
+        m_used[id - 1] = 0;
+        m_free.push_back(id - 1);
+        m_count--;
+        return true;
+    }
+
+    // Call f(id, record) for every record in use, in id order
+    template <typename F>
+    void ForEach(F f) const
+    {
+        for (size_t slot = 0; slot < m_used.size(); slot++)
+        {
+            if (m_used[slot])
+                f((uint32_t)(slot + 1), static_cast<const T&>(m_slabs[slot / SlabSize][slot % SlabSize]));
+        }
+    }
+
+    size_t Count() const { return m_count; }
+
+    // Records allocated, in use or not; slabs are only freed with the registry
+    size_t Capacity() const { return m_slabs.size() * SlabSize; }
+
+private:
+    std::vector<std::unique_ptr<T[]>> m_slabs;
+    std::vector<uint8_t> m_used; // per slot
+    std::vector<uint32_t> m_free;
+    size_t m_count;
+};
+
+#endif // _HANDLE_REGISTRY_H_
@@ -0,0 +1,154 @@
+/**
+ * MongoDB Extension HTTP Transport Implementation
+ */
+
+#include "http_transport.h"
+#include "json_utils.h"
+#include "request_trace.h"
+#include <curl/curl.h>
+
+static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp)
+{
+    std::string* response = static_cast<std::string*>(userp);
+    response->append(static_cast<char*>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+static int ProgressCallback(void* userp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    return static_cast<const std::atomic<bool>*>(userp)->load() ? 1 : 0;
+}
+
+bool HttpServicePost(const std::string& url, const std::string& body, const std::string& apiKey,
+                     std::string& response, long& statusCode, const std::atomic<bool>* cancel)
+{
+    statusCode = 0;
+    if (cancel && cancel->load())
+        return false; // not sent
+    RequestTraceScope trace((const char*)nullptr); // joins the caller's trace, if any
+
+    CURL* curl = curl_easy_init();
+    if (!curl)
+        return false;
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "User-Agent: SourceMod-MongoDB-Extension/1.0");
+    headers = curl_slist_append(headers, "X-SourceMod-Extension: MongoDB-HTTP-Extension");
+    headers = curl_slist_append(headers, "X-Extension-Version: 1.0.0");
+
+    std::string authHeader = "X-SourceMod-API-Key: " + apiKey;
+    headers = curl_slist_append(headers, authHeader.c_str());
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.length()));
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    if (cancel)
+    {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, cancel);
+    }
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); // Required outside the main thread
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L); // Matches EnhancedHTTPPost
+
+    int64_t sendUs = RequestTraceScope::BeginRequest();
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &statusCode);
+    if (res != CURLE_OK)
+    {
+        // Nothing reached the service if no request went out yet; otherwise
+        // it may have received all of it
+        long requestBytes = 0;
+        curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &requestBytes);
+        if (requestBytes > 0)
+            statusCode = HTTP_STATUS_ABORTED;
+    }
+    RequestTraceScope::EndRequest(sendUs, curl, url.c_str(), statusCode, res == CURLE_OK, body.length(), response.length());
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    return res == CURLE_OK;
+}
+
+bool HttpServiceUnavailable(bool transferred, long statusCode, const std::string& response)
+{
+    if (statusCode == HTTP_STATUS_ABORTED)
+        return false;
+    if (!transferred || statusCode == 429 || (statusCode >= 502 && statusCode <= 504))
+        return true;
+
+    // Proxies answer with HTML; the service always sends { "success": ... }
+    return response.find("\"success\"") == std::string::npos ||
+           response.find("\"CONNECTION_ERROR\"") != std::string::npos ||
+           response.find("\"DATABASE_UNAVAILABLE\"") != std::string::npos ||
+           response.find("\"CONNECTION_NOT_FOUND\"") != std::string::npos;
+}
+
+bool HttpServicePostData(const std::string& url, const std::string& body, const std::string& apiKey,
+                         std::string& data, const std::atomic<bool>* cancel)
+{
+    std::string response, success;
+    long statusCode;
+    return HttpServicePost(url, body, apiKey, response, statusCode, cancel) && statusCode < 400 &&
+           JsonGetMember(response, "success", success) && success == "true" &&
+           JsonGetMember(response, "data", data);
+}
+
+std::string HttpEncodePathSegment(const std::string& segment)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(segment.size());
+    for (unsigned char c : segment)
+    {
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '.' || c == '_' || c == '~')
+        {
+            encoded += (char)c;
+        }
+        else
+        {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0x0F];
+        }
+    }
+    return encoded;
+}
+
+static int HexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+std::string HttpDecodePathSegment(const std::string& segment)
+{
+    std::string decoded;
+    decoded.reserve(segment.size());
+    for (size_t i = 0; i < segment.size(); i++)
+    {
+        int high = segment[i] == '%' && i + 2 < segment.size() ? HexDigitValue(segment[i + 1]) : -1;
+        int low = high >= 0 ? HexDigitValue(segment[i + 2]) : -1;
+        if (low < 0)
+        {
+            decoded += segment[i];
+            continue;
+        }
+        decoded += (char)(high * 16 + low);
+        i += 2;
+    }
+    return decoded;
+}
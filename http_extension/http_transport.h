@@ -0,0 +1,43 @@
+/**
+ * MongoDB Extension HTTP Transport
+ * Thread-safe requests to the API service for background work. Unlike the
+ * helpers in complete_extension.cpp these never log through SourceMod and
+ * never touch the shared error/metrics state, so any thread may call them.
+ */
+
+#ifndef _HTTP_TRANSPORT_H_
+#define _HTTP_TRANSPORT_H_
+
+#include <string>
+#include <atomic>
+
+// statusCode of a request whose transfer broke off after it was sent: aborted
+// through *cancel, timed out or disconnected. The service may or may not have
+// applied it.
+const long HTTP_STATUS_ABORTED = -1;
+
+// POST a JSON body with the service's authentication headers.
+// Returns true if the transfer completed; statusCode holds the HTTP status.
+// Setting *cancel aborts a transfer in progress; once set, nothing is sent.
+bool HttpServicePost(const std::string& url, const std::string& body, const std::string& apiKey,
+                     std::string& response, long& statusCode, const std::atomic<bool>* cancel = nullptr);
+
+// Same, and extract the "data" member of a { "success": true } response
+bool HttpServicePostData(const std::string& url, const std::string& body, const std::string& apiKey,
+                         std::string& data, const std::atomic<bool>* cancel = nullptr);
+
+// True if a write should be tried again later: the service or its database
+// was unreachable, or the service was restarted and forgot the connection.
+// Never for HTTP_STATUS_ABORTED, as a retry could apply the write twice.
+// A failed transfer without a status code counts as one that sent nothing.
+// Pass statusCode 0 if only the response body is known.
+bool HttpServiceUnavailable(bool transferred, long statusCode, const std::string& response);
+
+// Percent-encode one path segment (a database, collection or index name);
+// only RFC 3986 unreserved characters are kept as they are
+std::string HttpEncodePathSegment(const std::string& segment);
+
+// Undo HttpEncodePathSegment; malformed escapes are kept as they are
+std::string HttpDecodePathSegment(const std::string& segment);
+
+#endif // _HTTP_TRANSPORT_H_
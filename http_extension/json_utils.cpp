@@ -0,0 +1,299 @@
+/**
+ * MongoDB Extension JSON Utilities Implementation
+ */
+
+#include "json_utils.h"
+#include <cctype>
+#include <cstdio>
+
+size_t JsonSkipWhitespace(const std::string& json, size_t pos)
+{
+    while (pos < json.length() && std::isspace(static_cast<unsigned char>(json[pos])))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+static size_t SkipString(const std::string& json, size_t pos)
+{
+    // pos points at the opening quote
+    for (size_t i = pos + 1; i < json.length(); i++)
+    {
+        if (json[i] == '\\')
+        {
+            i++;
+        }
+        else if (json[i] == '"')
+        {
+            return i + 1;
+        }
+    }
+    return std::string::npos;
+}
+
+size_t JsonSkipValue(const std::string& json, size_t pos)
+{
+    pos = JsonSkipWhitespace(json, pos);
+    if (pos >= json.length())
+        return std::string::npos;
+
+    char c = json[pos];
+    if (c == '"')
+        return SkipString(json, pos);
+
+    if (c == '{' || c == '[')
+    {
+        int depth = 0;
+        for (size_t i = pos; i < json.length(); i++)
+        {
+            if (json[i] == '"')
+            {
+                i = SkipString(json, i);
+                if (i == std::string::npos)
+                    return std::string::npos;
+                i--;
+            }
+            else if (json[i] == '{' || json[i] == '[')
+            {
+                depth++;
+            }
+            else if (json[i] == '}' || json[i] == ']')
+            {
+                if (--depth == 0)
+                    return i + 1;
+            }
+        }
+        return std::string::npos;
+    }
+
+    // Number, true, false or null
+    size_t end = pos;
+    while (end < json.length() && json[end] != ',' && json[end] != '}' && json[end] != ']' &&
+           !std::isspace(static_cast<unsigned char>(json[end])))
+    {
+        end++;
+    }
+    return end > pos ? end : std::string::npos;
+}
+
+bool JsonGetMember(const std::string& objectJson, const std::string& key, std::string& rawValue)
+{
+    size_t pos = JsonSkipWhitespace(objectJson, 0);
+    if (pos >= objectJson.length() || objectJson[pos] != '{')
+        return false;
+    pos++;
+
+    while (true)
+    {
+        pos = JsonSkipWhitespace(objectJson, pos);
+        if (pos >= objectJson.length() || objectJson[pos] == '}')
+            return false;
+        if (objectJson[pos] != '"')
+            return false;
+
+        size_t keyEnd = SkipString(objectJson, pos);
+        if (keyEnd == std::string::npos)
+            return false;
+        std::string memberKey = JsonUnquote(objectJson.substr(pos, keyEnd - pos));
+
+        pos = JsonSkipWhitespace(objectJson, keyEnd);
+        if (pos >= objectJson.length() || objectJson[pos] != ':')
+            return false;
+
+        size_t valueStart = JsonSkipWhitespace(objectJson, pos + 1);
+        size_t valueEnd = JsonSkipValue(objectJson, valueStart);
+        if (valueEnd == std::string::npos)
+            return false;
+
+        if (memberKey == key)
+        {
+            rawValue = objectJson.substr(valueStart, valueEnd - valueStart);
+            return true;
+        }
+
+        pos = JsonSkipWhitespace(objectJson, valueEnd);
+        if (pos < objectJson.length() && objectJson[pos] == ',')
+            pos++;
+    }
+}
+
+bool JsonGetPath(const std::string& objectJson, const std::string& path, std::string& rawValue)
+{
+    std::string current = objectJson;
+    size_t start = 0;
+    while (true)
+    {
+        size_t dot = path.find('.', start);
+        std::string part = path.substr(start, dot == std::string::npos ? std::string::npos : dot - start);
+        std::string value;
+        if (!JsonGetMember(current, part, value))
+            return false;
+
+        if (dot == std::string::npos)
+        {
+            rawValue = value;
+            return true;
+        }
+
+        current = value;
+        start = dot + 1;
+    }
+}
+
+bool JsonSplitArray(const std::string& arrayJson, std::vector<std::string>& elements)
+{
+    size_t pos = JsonSkipWhitespace(arrayJson, 0);
+    if (pos >= arrayJson.length() || arrayJson[pos] != '[')
+        return false;
+    pos++;
+
+    while (true)
+    {
+        pos = JsonSkipWhitespace(arrayJson, pos);
+        if (pos >= arrayJson.length())
+            return false;
+        if (arrayJson[pos] == ']')
+            return true;
+
+        size_t end = JsonSkipValue(arrayJson, pos);
+        if (end == std::string::npos)
+            return false;
+        elements.push_back(arrayJson.substr(pos, end - pos));
+
+        pos = JsonSkipWhitespace(arrayJson, end);
+        if (pos < arrayJson.length() && arrayJson[pos] == ',')
+            pos++;
+    }
+}
+
+bool JsonSplitObject(const std::string& objectJson, std::vector<std::pair<std::string, std::string>>& members)
+{
+    size_t pos = JsonSkipWhitespace(objectJson, 0);
+    if (pos >= objectJson.length() || objectJson[pos] != '{')
+        return false;
+    pos++;
+
+    while (true)
+    {
+        pos = JsonSkipWhitespace(objectJson, pos);
+        if (pos >= objectJson.length())
+            return false;
+        if (objectJson[pos] == '}')
+            return true;
+        if (objectJson[pos] != '"')
+            return false;
+
+        size_t keyEnd = SkipString(objectJson, pos);
+        if (keyEnd == std::string::npos)
+            return false;
+
+        size_t colon = JsonSkipWhitespace(objectJson, keyEnd);
+        if (colon >= objectJson.length() || objectJson[colon] != ':')
+            return false;
+
+        size_t valueStart = JsonSkipWhitespace(objectJson, colon + 1);
+        size_t valueEnd = JsonSkipValue(objectJson, valueStart);
+        if (valueEnd == std::string::npos)
+            return false;
+
+        members.emplace_back(objectJson.substr(pos, keyEnd - pos), objectJson.substr(valueStart, valueEnd - valueStart));
+
+        pos = JsonSkipWhitespace(objectJson, valueEnd);
+        if (pos < objectJson.length() && objectJson[pos] == ',')
+            pos++;
+    }
+}
+
+std::string JsonCompact(const std::string& json)
+{
+    std::string result;
+    result.reserve(json.length());
+
+    bool inString = false;
+    for (size_t i = 0; i < json.length(); i++)
+    {
+        char c = json[i];
+        if (inString)
+        {
+            result += c;
+            if (c == '\\' && i + 1 < json.length())
+            {
+                result += json[++i];
+            }
+            else if (c == '"')
+            {
+                inString = false;
+            }
+        }
+        else if (c == '"')
+        {
+            inString = true;
+            result += c;
+        }
+        else if (!std::isspace(static_cast<unsigned char>(c)))
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+std::string JsonUnquote(const std::string& rawValue)
+{
+    if (rawValue.length() < 2 || rawValue.front() != '"' || rawValue.back() != '"')
+        return rawValue;
+
+    std::string result;
+    for (size_t i = 1; i + 1 < rawValue.length(); i++)
+    {
+        char c = rawValue[i];
+        if (c != '\\' || i + 2 >= rawValue.length())
+        {
+            result += c;
+            continue;
+        }
+
+        char e = rawValue[++i];
+        switch (e)
+        {
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': result += "\\u"; break; // keep \u escapes as-is
+            default: result += e; break;
+        }
+    }
+    return result;
+}
+
+std::string JsonQuote(const std::string& value)
+{
+    std::string result = "\"";
+    for (char c : value)
+    {
+        switch (c)
+        {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                    result += escaped;
+                }
+                else
+                {
+                    result += c;
+                }
+                break;
+        }
+    }
+    return result + "\"";
+}
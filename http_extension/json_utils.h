@@ -0,0 +1,41 @@
+/**
+ * MongoDB Extension JSON Utilities
+ * Lightweight scanning helpers for API service responses
+ */
+
+#ifndef _JSON_UTILS_H_
+#define _JSON_UTILS_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// Skip whitespace starting at pos and return the first non-space index
+size_t JsonSkipWhitespace(const std::string& json, size_t pos);
+
+// Skip one JSON value starting at pos; returns the index just past it,
+// or std::string::npos if the value is malformed
+size_t JsonSkipValue(const std::string& json, size_t pos);
+
+// Get the raw text of a top-level member of a JSON object
+bool JsonGetMember(const std::string& objectJson, const std::string& key, std::string& rawValue);
+
+// Same as JsonGetMember but follows a dotted path ("stats.kills")
+bool JsonGetPath(const std::string& objectJson, const std::string& path, std::string& rawValue);
+
+// Split a JSON array into the raw text of its elements
+bool JsonSplitArray(const std::string& arrayJson, std::vector<std::string>& elements);
+
+// Split a JSON object into the raw text of its keys (quoted) and values
+bool JsonSplitObject(const std::string& objectJson, std::vector<std::pair<std::string, std::string>>& members);
+
+// Remove whitespace outside of string literals
+std::string JsonCompact(const std::string& json);
+
+// Decode a raw JSON string literal ("...") into its value
+std::string JsonUnquote(const std::string& rawValue);
+
+// Encode a value as a JSON string literal, quotes included
+std::string JsonQuote(const std::string& value);
+
+#endif // _JSON_UTILS_H_
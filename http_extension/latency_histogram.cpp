@@ -0,0 +1,191 @@
+/**
+ * MongoDB Extension Latency Histograms Implementation
+ */
+
+#include "latency_histogram.h"
+#include <chrono>
+#include <limits>
+
+LatencyWindow::LatencyWindow()
+{
+    for (Slice& slice : m_slices)
+    {
+        slice.epoch.store(std::numeric_limits<int64_t>::min(), std::memory_order_relaxed);
+        slice.max.store(0, std::memory_order_relaxed);
+        for (std::atomic<uint32_t>& count : slice.counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyWindow::BucketOf(uint64_t micros)
+{
+    if (micros < (uint64_t)SUB_BUCKETS)
+        return (int)micros;
+    int magnitude = 63;
+    while (!(micros >> magnitude))
+        magnitude--;
+    if (magnitude > MAX_MAGNITUDE)
+        return BUCKETS - 1;
+    // magnitude >= 5: the top bit and the next five pick the bucket
+    return SUB_BUCKETS * (magnitude - 4) + (int)((micros >> (magnitude - 5)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t LatencyWindow::BucketUpperBound(int bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return (uint64_t)bucket;
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+int64_t LatencyWindow::CurrentEpoch()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() / LATENCY_SLICE_SECONDS;
+}
+
+void LatencyWindow::Record(uint64_t micros)
+{
+    int64_t now = CurrentEpoch();
+    Slice& slice = m_slices[now % LATENCY_WINDOW_SLICES];
+
+    int64_t epoch = slice.epoch.load(std::memory_order_acquire);
+    if (epoch < now && slice.epoch.compare_exchange_strong(epoch, now, std::memory_order_acq_rel))
+    {
+        // This slice last held the counts of a full window ago
+        for (std::atomic<uint32_t>& count : slice.counts)
+            count.store(0, std::memory_order_relaxed);
+        slice.max.store(0, std::memory_order_relaxed);
+    }
+
+    slice.counts[BucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = slice.max.load(std::memory_order_relaxed);
+    while (micros > max && !slice.max.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyWindow::Summary LatencyWindow::Summarize() const
+{
+    Summary summary = {};
+    int64_t now = CurrentEpoch();
+
+    uint64_t counts[BUCKETS] = {};
+    for (const Slice& slice : m_slices)
+    {
+        int64_t epoch = slice.epoch.load(std::memory_order_acquire);
+        if (epoch <= now - LATENCY_WINDOW_SLICES || epoch > now)
+            continue;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            uint32_t count = slice.counts[i].load(std::memory_order_relaxed);
+            counts[i] += count;
+            summary.count += count;
+        }
+        uint64_t max = slice.max.load(std::memory_order_relaxed);
+        if (max > summary.max)
+            summary.max = max;
+    }
+    if (summary.count == 0)
+        return summary;
+
+    // Smallest bucket holding at least the given share of the requests,
+    // reported as its upper bound but never above the largest value seen
+    uint64_t p50Rank = (summary.count * 50 + 99) / 100;
+    uint64_t p90Rank = (summary.count * 90 + 99) / 100;
+    uint64_t p99Rank = (summary.count * 99 + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS && seen < p99Rank; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        uint64_t upper = BucketUpperBound(i);
+        if (upper > summary.max)
+            upper = summary.max;
+        uint64_t before = seen;
+        seen += counts[i];
+        if (before < p50Rank && seen >= p50Rank)
+            summary.p50 = upper;
+        if (before < p90Rank && seen >= p90Rank)
+            summary.p90 = upper;
+        if (seen >= p99Rank)
+            summary.p99 = upper;
+    }
+    return summary;
+}
+
+const char* LatencyTracker::GetOperationName(Operation op)
+{
+    switch (op)
+    {
+        case Op_All:              return "all";
+        case Op_InsertOne:        return "insertOne";
+        case Op_InsertMany:       return "insertMany";
+        case Op_FindOne:          return "findOne";
+        case Op_Find:             return "find";
+        case Op_Aggregate:        return "aggregate";
+        case Op_Distinct:         return "distinct";
+        case Op_CountDocuments:   return "countDocuments";
+        case Op_UpdateOne:        return "updateOne";
+        case Op_UpdateMany:       return "updateMany";
+        case Op_FindOneAndUpdate: return "findOneAndUpdate";
+        case Op_DeleteOne:        return "deleteOne";
+        case Op_DeleteMany:       return "deleteMany";
+        case Op_BulkWrite:        return "bulkWrite";
+        case Op_Index:            return "index";
+        case Op_Batch:            return "batch";
+        case Op_HealthCheck:      return "healthCheck";
+        default:                  return "unknown";
+    }
+}
+
+LatencyWindow* LatencyTracker::GetCollectionWindow(const std::string& collectionKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<LatencyWindow>& window = m_collections[collectionKey];
+    if (!window)
+        window.reset(new LatencyWindow());
+    return window.get();
+}
+
+void LatencyTracker::Record(Operation op, LatencyWindow* collection, uint64_t micros)
+{
+    if (op > Op_All && op < OPERATION_COUNT)
+        m_operations[op].Record(micros);
+    m_operations[Op_All].Record(micros);
+    if (collection)
+        collection->Record(micros);
+}
+
+LatencyWindow::Summary LatencyTracker::Summarize(Operation op) const
+{
+    if (op < Op_All || op >= OPERATION_COUNT)
+        return LatencyWindow::Summary();
+    return m_operations[op].Summarize();
+}
+
+std::vector<std::pair<std::string, LatencyWindow::Summary>> LatencyTracker::SummarizeCollections() const
+{
+    std::vector<std::pair<std::string, LatencyWindow::Summary>> result;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_collections)
+    {
+        LatencyWindow::Summary summary = entry.second->Summarize();
+        if (summary.count > 0)
+            result.emplace_back(entry.first, summary);
+    }
+    return result;
+}
+
+size_t LatencyTracker::GetMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t bytes = sizeof(m_operations);
+    for (const auto& entry : m_collections)
+    {
+        // map node: key, pointer and tree links
+        bytes += sizeof(LatencyWindow) + entry.first.capacity() + 48;
+    }
+    return bytes;
+}
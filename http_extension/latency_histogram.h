@@ -0,0 +1,112 @@
+/**
+ * MongoDB Extension Latency Histograms
+ * HDR-style request latency histograms per operation type and per
+ * collection over a sliding window. Recording is lock-free, so the
+ * async worker and the game thread record into the same histograms.
+ */
+
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// Latencies of the last LATENCY_WINDOW_SLICES * LATENCY_SLICE_SECONDS seconds
+const int LATENCY_SLICE_SECONDS = 10;
+const int LATENCY_WINDOW_SLICES = 6;
+
+class LatencyWindow
+{
+public:
+    struct Summary
+    {
+        uint64_t count;
+        uint64_t p50;   // microseconds
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    // Values below 32 us are exact; above, each power of two is split into 32
+    // buckets, so a reported percentile is at most ~3% above the real one.
+    // Latencies of 2^27 us (134 s) or more count as the largest bucket.
+    static const int SUB_BUCKETS = 32;
+    static const int MAX_MAGNITUDE = 26;
+    static const int BUCKETS = SUB_BUCKETS * (MAX_MAGNITUDE - 3);
+
+    LatencyWindow();
+
+    void Record(uint64_t micros);
+    Summary Summarize() const;
+
+private:
+    struct Slice
+    {
+        std::atomic<int64_t> epoch; // time / LATENCY_SLICE_SECONDS the counts belong to
+        std::atomic<uint64_t> max;
+        std::atomic<uint32_t> counts[BUCKETS];
+    };
+
+    static int BucketOf(uint64_t micros);
+    static uint64_t BucketUpperBound(int bucket);
+    static int64_t CurrentEpoch();
+
+    // A slice is cleared by the first Record of its new epoch; a Record racing
+    // with the clear may be lost, which only affects the slice boundary
+    Slice m_slices[LATENCY_WINDOW_SLICES];
+};
+
+class LatencyTracker
+{
+public:
+    enum Operation
+    {
+        Op_All = 0,         // every operation below
+        Op_InsertOne,
+        Op_InsertMany,
+        Op_FindOne,
+        Op_Find,
+        Op_Aggregate,
+        Op_Distinct,
+        Op_CountDocuments,
+        Op_UpdateOne,
+        Op_UpdateMany,
+        Op_FindOneAndUpdate,
+        Op_DeleteOne,
+        Op_DeleteMany,
+        Op_BulkWrite,
+        Op_Index,           // CreateIndex and DropIndex
+        Op_Batch,
+        Op_HealthCheck,     // TestConnection
+        OPERATION_COUNT
+    };
+
+    static const char* GetOperationName(Operation op);
+
+    // Window of a collection (document cache key), created on first use.
+    // Windows are never freed, so the pointer stays valid.
+    LatencyWindow* GetCollectionWindow(const std::string& collectionKey);
+
+    // Record one request in the operation's window, Op_All and the
+    // collection's window (may be null). Safe to call from any thread.
+    void Record(Operation op, LatencyWindow* collection, uint64_t micros);
+
+    LatencyWindow::Summary Summarize(Operation op) const;
+    std::vector<std::pair<std::string, LatencyWindow::Summary>> SummarizeCollections() const;
+
+    // Bytes of the histograms, for memory accounting
+    size_t GetMemoryUsage() const;
+
+private:
+    LatencyWindow m_operations[OPERATION_COUNT];
+
+    mutable std::mutex m_mutex; // guards m_collections; Record does not take it
+    std::map<std::string, std::unique_ptr<LatencyWindow>> m_collections;
+};
+
+#endif // _LATENCY_HISTOGRAM_H_
@@ -0,0 +1,147 @@
+/**
+ * MongoDB Extension Native Profiler Implementation
+ */
+
+#include "native_profiler.h"
+
+NativeProfiler::NativeProfiler()
+    : m_depth(0)
+    , m_calls(0)
+    , m_totalNs(0)
+    , m_frames(0)
+    , m_stalledFrames(0)
+    , m_frame()
+    , m_nextStall(0)
+{
+}
+
+uint32_t NativeProfiler::Register(const char* name)
+{
+    NativeStats stats = { name, 0, 0, 0, nullptr };
+    m_natives.push_back(stats);
+    return (uint32_t)(m_natives.size() - 1);
+}
+
+void NativeProfiler::Leave(uint32_t native, const void* caller, uint64_t ns)
+{
+    m_depth--;
+
+    NativeStats& stats = m_natives[native];
+    stats.calls++;
+    stats.totalNs += ns;
+    if (ns > stats.maxNs)
+    {
+        stats.maxNs = ns;
+        stats.maxCaller = caller;
+    }
+
+    CallSite& site = m_callSites[std::make_pair(caller, native)];
+    site.caller = caller;
+    site.native = native;
+    site.calls++;
+    site.totalNs += ns;
+    if (ns > site.maxNs)
+        site.maxNs = ns;
+
+    if (m_depth > 0)
+        return;
+    m_calls++;
+    m_totalNs += ns;
+    m_frame.calls++;
+    m_frame.totalNs += ns;
+    if (ns > m_frame.worstNs)
+    {
+        m_frame.worstNs = ns;
+        m_frame.worstNative = native;
+        m_frame.worstCaller = caller;
+    }
+}
+
+bool NativeProfiler::EndFrame(uint64_t thresholdNs)
+{
+    bool stalled = m_frame.totalNs > thresholdNs;
+    if (stalled)
+    {
+        m_frame.frame = m_frames;
+        m_frame.time = time(nullptr);
+        if (m_stalls.size() < STALL_HISTORY)
+            m_stalls.push_back(m_frame);
+        else
+            m_stalls[m_nextStall] = m_frame;
+        m_nextStall = (m_nextStall + 1) % STALL_HISTORY;
+        m_stalledFrames++;
+    }
+
+    m_frames++;
+    m_frame = StalledFrame();
+    return stalled;
+}
+
+void NativeProfiler::ForgetCaller(const void* caller)
+{
+    for (auto it = m_callSites.lower_bound(std::make_pair(caller, (uint32_t)0));
+         it != m_callSites.end() && it->first.first == caller;)
+        it = m_callSites.erase(it);
+    for (NativeStats& stats : m_natives)
+    {
+        if (stats.maxCaller == caller)
+            stats.maxCaller = nullptr;
+    }
+    for (StalledFrame& stall : m_stalls)
+    {
+        if (stall.worstCaller == caller)
+            stall.worstCaller = nullptr;
+    }
+    if (m_frame.worstCaller == caller)
+        m_frame.worstCaller = nullptr;
+}
+
+void NativeProfiler::Reset()
+{
+    for (NativeStats& stats : m_natives)
+    {
+        stats.calls = 0;
+        stats.totalNs = 0;
+        stats.maxNs = 0;
+        stats.maxCaller = nullptr;
+    }
+    m_callSites.clear();
+    m_calls = 0;
+    m_totalNs = 0;
+    m_frames = 0;
+    m_stalledFrames = 0;
+    m_frame = StalledFrame();
+    m_stalls.clear();
+    m_nextStall = 0;
+}
+
+NativeProfiler::Totals NativeProfiler::GetTotals() const
+{
+    Totals totals = { m_calls, m_totalNs, m_frames, m_stalledFrames };
+    return totals;
+}
+
+std::vector<NativeProfiler::CallSite> NativeProfiler::GetCallSites() const
+{
+    std::vector<CallSite> sites;
+    sites.reserve(m_callSites.size());
+    for (const auto& entry : m_callSites)
+        sites.push_back(entry.second);
+    return sites;
+}
+
+std::vector<NativeProfiler::StalledFrame> NativeProfiler::GetStalledFrames() const
+{
+    if (m_stalls.size() < STALL_HISTORY)
+        return m_stalls;
+    std::vector<StalledFrame> stalls(m_stalls.begin() + m_nextStall, m_stalls.end());
+    stalls.insert(stalls.end(), m_stalls.begin(), m_stalls.begin() + m_nextStall);
+    return stalls;
+}
+
+const NativeProfiler::StalledFrame* NativeProfiler::GetLastStall() const
+{
+    if (m_stalls.empty())
+        return nullptr;
+    return &m_stalls[(m_nextStall + STALL_HISTORY - 1) % STALL_HISTORY];
+}
@@ -0,0 +1,103 @@
+/**
+ * MongoDB Extension Native Profiler
+ * Game-thread time spent inside the extension's natives, per native and per
+ * calling plugin, and the frames in which that time exceeded a threshold
+ */
+
+#ifndef _NATIVE_PROFILER_H_
+#define _NATIVE_PROFILER_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+
+// Callers are opaque (the plugin's identity token); the extension resolves
+// them to plugin names when printing. Game thread only, like the natives.
+class NativeProfiler
+{
+public:
+    struct NativeStats
+    {
+        const char* name;
+        uint64_t calls;
+        uint64_t totalNs;
+        uint64_t maxNs;
+        const void* maxCaller;   // caller of the slowest call, null once it unloaded
+    };
+
+    // One native as called by one plugin
+    struct CallSite
+    {
+        const void* caller;
+        uint32_t native;
+        uint64_t calls;
+        uint64_t totalNs;
+        uint64_t maxNs;
+    };
+
+    struct StalledFrame
+    {
+        uint64_t frame;          // frames counted before it
+        time_t time;
+        uint64_t totalNs;        // native time in the frame
+        uint32_t calls;
+        uint32_t worstNative;    // slowest call of the frame
+        const void* worstCaller;
+        uint64_t worstNs;
+    };
+
+    struct Totals
+    {
+        uint64_t calls;
+        uint64_t totalNs;
+        uint64_t frames;
+        uint64_t stalledFrames;
+    };
+
+    // Stalled frames kept for GetStalledFrames
+    static const size_t STALL_HISTORY = 16;
+
+    NativeProfiler();
+
+    // Index of a native for Enter/Leave; name must outlive the profiler
+    uint32_t Register(const char* name);
+
+    // Bracket a native call; nested calls count towards their own native but
+    // only the outermost one towards the frame
+    void Enter() { m_depth++; }
+    void Leave(uint32_t native, const void* caller, uint64_t ns);
+
+    // Close the current frame (game frame hook). Returns true if the natives
+    // called since the last call took more than thresholdNs.
+    bool EndFrame(uint64_t thresholdNs);
+
+    // Drop the call sites of an unloaded plugin so a new one reusing its
+    // identity does not inherit them
+    void ForgetCaller(const void* caller);
+
+    void Reset();
+
+    Totals GetTotals() const;
+    const std::vector<NativeStats>& GetNatives() const { return m_natives; }
+    std::vector<CallSite> GetCallSites() const;
+    std::vector<StalledFrame> GetStalledFrames() const; // oldest first
+    const StalledFrame* GetLastStall() const;
+
+private:
+    std::vector<NativeStats> m_natives;
+    std::map<std::pair<const void*, uint32_t>, CallSite> m_callSites;
+
+    int m_depth;
+    uint64_t m_calls;
+    uint64_t m_totalNs;
+    uint64_t m_frames;
+    uint64_t m_stalledFrames;
+
+    StalledFrame m_frame; // being collected
+    std::vector<StalledFrame> m_stalls; // ring of STALL_HISTORY
+    size_t m_nextStall;
+};
+
+#endif // _NATIVE_PROFILER_H_
@@ -0,0 +1,76 @@
+/**
+ * MongoDB Extension Per-Plugin Usage Implementation
+ */
+
+#include "plugin_usage.h"
+
+void PluginUsage::RecordRequest(const void* plugin, size_t bytesSent, size_t bytesReceived, bool success,
+                                uint64_t micros, size_t requests)
+{
+    if (!plugin)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Counters& counters = m_plugins[plugin];
+    counters.requests += requests;
+    if (!success)
+        counters.errors++;
+    counters.bytesSent += bytesSent;
+    counters.bytesReceived += bytesReceived;
+    counters.latencyUs += micros;
+}
+
+void PluginUsage::RecordCacheHits(const void* plugin, size_t hits)
+{
+    if (!plugin || hits == 0)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_plugins[plugin].cacheHits += hits;
+}
+
+void PluginUsage::RecordQueued(const void* plugin, size_t bytes)
+{
+    if (!plugin)
+        return;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Counters& counters = m_plugins[plugin];
+    counters.queued++;
+    counters.queuedBytes += bytes;
+}
+
+bool PluginUsage::Get(const void* plugin, Counters& counters) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_plugins.find(plugin);
+    if (it == m_plugins.end())
+    {
+        counters = Counters();
+        return false;
+    }
+    counters = it->second;
+    return true;
+}
+
+std::map<const void*, PluginUsage::Counters> PluginUsage::GetAll() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_plugins;
+}
+
+void PluginUsage::Forget(const void* plugin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_plugins.erase(plugin);
+}
+
+void PluginUsage::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_plugins.clear();
+}
+
+size_t PluginUsage::GetMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // map node: key, counters and tree links
+    return m_plugins.size() * (sizeof(const void*) + sizeof(Counters) + 32);
+}
@@ -0,0 +1,54 @@
+/**
+ * MongoDB Extension Per-Plugin Usage
+ * Requests, bytes, cache hits, errors and request time booked to the plugin
+ * whose native started them, so the plugins that load the database most
+ * can be found when many share the extension.
+ */
+
+#ifndef _PLUGIN_USAGE_H_
+#define _PLUGIN_USAGE_H_
+
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+class PluginUsage
+{
+public:
+    struct Counters
+    {
+        uint64_t requests;      // sent to the API service
+        uint64_t errors;        // requests that failed or that the service rejected
+        uint64_t bytesSent;     // request bodies
+        uint64_t bytesReceived; // response bodies
+        uint64_t latencyUs;     // summed time of the requests
+        uint64_t cacheHits;     // reads answered by the read cache instead of a request
+        uint64_t queued;        // writes handed to write-behind, the coalescer or an event stream
+        uint64_t queuedBytes;
+    };
+
+    // Plugins are identified by their identity token; null (no calling
+    // plugin) is not booked. All methods are thread-safe. An operation split
+    // into several requests is booked once with their count and total bytes.
+    void RecordRequest(const void* plugin, size_t bytesSent, size_t bytesReceived, bool success, uint64_t micros,
+                       size_t requests = 1);
+    void RecordCacheHits(const void* plugin, size_t hits);
+    void RecordQueued(const void* plugin, size_t bytes);
+
+    // Returns false if nothing was booked to the plugin
+    bool Get(const void* plugin, Counters& counters) const;
+    std::map<const void*, Counters> GetAll() const;
+
+    // Drop an unloaded plugin's counters; its identity may be reused
+    void Forget(const void* plugin);
+    void Reset();
+
+    size_t GetMemoryUsage() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<const void*, Counters> m_plugins;
+};
+
+#endif // _PLUGIN_USAGE_H_
@@ -0,0 +1,274 @@
+/**
+ * MongoDB Extension Request Tracing Implementation
+ */
+
+#include "request_trace.h"
+#include "json_utils.h"
+#include <curl/curl.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// Traces kept for export; the oldest are overwritten
+static const size_t REQUEST_TRACE_CAPACITY = 4096;
+
+RequestTracer g_requestTracer(REQUEST_TRACE_CAPACITY);
+
+static thread_local RequestTraceScope* t_scope = nullptr;
+
+RequestTracer::RequestTracer(size_t capacity)
+    : m_sampleRate(0)
+    , m_seen(0)
+    , m_sampled(0)
+    , m_mainThread(0)
+    , m_capacity(capacity)
+    , m_next(0)
+{
+}
+
+int64_t RequestTracer::NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t RequestTracer::CurrentThread()
+{
+    static std::atomic<uint32_t> nextThread(1);
+    static thread_local uint32_t thread = 0;
+    if (thread == 0)
+        thread = nextThread++;
+    return thread;
+}
+
+bool RequestTracer::Sample()
+{
+    uint64_t seen = ++m_seen;
+    int rate = m_sampleRate;
+    if (rate == 0 || seen % rate != 0)
+        return false;
+    m_sampled++;
+    return true;
+}
+
+void RequestTracer::Submit(Trace&& trace)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_traces.size() < m_capacity)
+        m_traces.push_back(std::move(trace));
+    else
+        m_traces[m_next] = std::move(trace);
+    m_next = (m_next + 1) % m_capacity;
+}
+
+RequestTracer::Stats RequestTracer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = { m_sampleRate, m_seen, m_sampled, m_traces.size(), m_capacity };
+    return stats;
+}
+
+void RequestTracer::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_traces.clear();
+    m_next = 0;
+}
+
+// One complete ("X") event; spans of zero or negative length are left out
+static void AppendSpan(std::string& out, const char* name, uint32_t thread, int64_t begin, int64_t end,
+                       const std::string& args = std::string())
+{
+    if (end <= begin)
+        return;
+    if (out.back() != '[')
+        out += ",\n";
+    out += "{\"name\":" + JsonQuote(name) + ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(thread) +
+           ",\"ts\":" + std::to_string(begin) + ",\"dur\":" + std::to_string(end - begin);
+    if (!args.empty())
+        out += ",\"args\":" + args;
+    out += "}";
+}
+
+bool RequestTracer::ExportChromeTrace(const std::string& path, size_t& exported, std::string& error) const
+{
+    std::vector<Trace> traces;
+    uint32_t mainThread = m_mainThread;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_traces.size() < m_capacity)
+        {
+            traces = m_traces;
+        }
+        else
+        {
+            // Oldest first
+            traces.assign(m_traces.begin() + m_next, m_traces.end());
+            traces.insert(traces.end(), m_traces.begin(), m_traces.begin() + m_next);
+        }
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    std::vector<uint32_t> threads;
+    for (const Trace& trace : traces)
+    {
+        if (trace.thread != mainThread && std::find(threads.begin(), threads.end(), trace.thread) == threads.end())
+            threads.push_back(trace.thread);
+
+        const Request& first = trace.requests.front();
+        const Request& last = trace.requests.back();
+        std::string name = trace.origin ? trace.origin : first.path.substr(first.path.rfind('/') + 1);
+        int64_t begin = trace.queuedUs ? trace.queuedUs : trace.beginUs;
+
+        std::string args = "{\"requests\":" + std::to_string(trace.requests.size()) + "}";
+        AppendSpan(out, name.c_str(), trace.thread, begin, trace.endUs, args);
+        if (trace.queuedUs)
+            AppendSpan(out, "queue", trace.thread, trace.queuedUs, trace.beginUs);
+        AppendSpan(out, "serialize", trace.thread, trace.beginUs, first.sendUs);
+
+        for (const Request& request : trace.requests)
+        {
+            std::string requestArgs = "{\"path\":" + JsonQuote(request.path) +
+                                      ",\"status\":" + std::to_string(request.statusCode) +
+                                      ",\"transferred\":" + (request.transferred ? "true" : "false") +
+                                      ",\"sent\":" + std::to_string(request.requestBytes) +
+                                      ",\"received\":" + std::to_string(request.responseBytes) + "}";
+            int64_t send = request.sendUs;
+            AppendSpan(out, "request", trace.thread, send, send + request.totalUs, requestArgs);
+            AppendSpan(out, "dns", trace.thread, send, send + request.nameLookupUs);
+            AppendSpan(out, "connect", trace.thread, send + request.nameLookupUs, send + request.connectUs);
+            if (request.appConnectUs)
+                AppendSpan(out, "tls", trace.thread, send + request.connectUs, send + request.appConnectUs);
+            AppendSpan(out, "server", trace.thread, send + request.preTransferUs, send + request.startTransferUs);
+            AppendSpan(out, "transfer", trace.thread, send + request.startTransferUs, send + request.totalUs);
+        }
+        AppendSpan(out, "decode", trace.thread, last.sendUs + last.totalUs, trace.endUs);
+    }
+
+    if (mainThread)
+    {
+        if (out.back() != '[')
+            out += ",\n";
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(mainThread) +
+               ",\"args\":{\"name\":\"game thread\"}}";
+    }
+    for (uint32_t thread : threads)
+    {
+        if (out.back() != '[')
+            out += ",\n";
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread) +
+               ",\"args\":{\"name\":\"worker " + std::to_string(thread) + "\"}}";
+    }
+    out += "]}\n";
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        error = "Cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    bool written = fwrite(out.data(), out.length(), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        error = "Cannot write " + path;
+        return false;
+    }
+    exported = traces.size();
+    return true;
+}
+
+RequestTraceScope::RequestTraceScope(const char* origin, int64_t queuedUs)
+    : m_owner(t_scope == nullptr)
+    , m_parent(nullptr)
+    , m_decided(false)
+    , m_sampled(false)
+{
+    if (!m_owner)
+        return;
+    t_scope = this;
+    m_trace.origin = origin;
+    m_trace.thread = 0;
+    m_trace.queuedUs = queuedUs;
+    m_trace.beginUs = RequestTracer::NowUs();
+    m_trace.endUs = 0;
+}
+
+RequestTraceScope::RequestTraceScope(RequestTraceScope* parent)
+    : m_owner(t_scope == nullptr && parent != nullptr)
+    , m_parent(parent)
+    , m_decided(false)
+    , m_sampled(false)
+{
+    if (m_owner)
+        t_scope = this;
+}
+
+RequestTraceScope::~RequestTraceScope()
+{
+    if (!m_owner)
+        return;
+    t_scope = nullptr;
+    if (m_parent)
+        return; // the parent submits the requests
+    if (m_sampled && !m_trace.requests.empty())
+    {
+        m_trace.endUs = RequestTracer::NowUs();
+        m_trace.thread = RequestTracer::CurrentThread();
+        g_requestTracer.Submit(std::move(m_trace));
+    }
+}
+
+RequestTraceScope* RequestTraceScope::Current()
+{
+    return t_scope;
+}
+
+RequestTraceScope* RequestTraceScope::Root()
+{
+    RequestTraceScope* scope = this;
+    while (scope->m_parent)
+        scope = scope->m_parent;
+    return scope;
+}
+
+int64_t RequestTraceScope::BeginRequest()
+{
+    RequestTraceScope* scope = t_scope ? t_scope->Root() : nullptr;
+    if (!scope)
+        return 0;
+    std::lock_guard<std::mutex> lock(scope->m_mutex);
+    if (!scope->m_decided)
+    {
+        scope->m_decided = true;
+        scope->m_sampled = g_requestTracer.Sample();
+    }
+    return scope->m_sampled ? RequestTracer::NowUs() : 0;
+}
+
+void RequestTraceScope::EndRequest(int64_t sendUs, void* curl, const char* url, long statusCode, bool transferred,
+                                   size_t requestBytes, size_t responseBytes)
+{
+    RequestTraceScope* scope = t_scope ? t_scope->Root() : nullptr;
+    if (sendUs == 0 || !scope)
+        return;
+
+    curl_off_t nameLookup = 0, connect = 0, appConnect = 0, preTransfer = 0, startTransfer = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appConnect);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &preTransfer);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+    const char* path = strstr(url, "://");
+    path = path ? strchr(path + 3, '/') : url;
+
+    RequestTracer::Request request = { path ? path : "/", sendUs, (int64_t)nameLookup, (int64_t)connect,
+                                       (int64_t)appConnect, (int64_t)preTransfer, (int64_t)startTransfer,
+                                       (int64_t)total, statusCode, transferred, requestBytes, responseBytes };
+    std::lock_guard<std::mutex> lock(scope->m_mutex);
+    scope->m_trace.requests.push_back(std::move(request));
+}
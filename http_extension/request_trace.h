@@ -0,0 +1,141 @@
+/**
+ * MongoDB Extension Request Tracing
+ * Timestamps of every stage of a sample of the requests to the API service:
+ * queueing, serialization, the network phases curl reports, and decoding.
+ * Kept in a ring buffer that can be written out as Chrome trace-event JSON
+ * (chrome://tracing, Perfetto).
+ */
+
+#ifndef _REQUEST_TRACE_H_
+#define _REQUEST_TRACE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+class RequestTracer
+{
+public:
+    // One HTTP request of a trace. The curl times are microseconds after
+    // sendUs and cumulative, as CURLINFO_*_TIME_T reports them; a phase that
+    // did not happen (a reused connection, no TLS) is 0.
+    struct Request
+    {
+        std::string path;           // URL without scheme and host
+        int64_t sendUs;             // curl_easy_perform called
+        int64_t nameLookupUs;
+        int64_t connectUs;
+        int64_t appConnectUs;       // TLS handshake done
+        int64_t preTransferUs;
+        int64_t startTransferUs;    // first response byte
+        int64_t totalUs;
+        long statusCode;
+        bool transferred;
+        size_t requestBytes;
+        size_t responseBytes;
+    };
+
+    // Everything a native call or background batch spent on its requests.
+    // Times are microseconds on the steady clock.
+    struct Trace
+    {
+        const char* origin;         // native or component; null names it after its first request
+        uint32_t thread;            // see CurrentThread
+        int64_t queuedUs;           // handed to a worker thread, or 0
+        int64_t beginUs;            // work on the request started; serialization until the first send
+        int64_t endUs;              // response decoded
+        std::vector<Request> requests;
+    };
+
+    struct Stats
+    {
+        int sampleRate;
+        uint64_t seen;              // traces that made a request
+        uint64_t sampled;
+        size_t buffered;
+        size_t capacity;
+    };
+
+    explicit RequestTracer(size_t capacity);
+
+    // Keep 1 in rate traces; 0 turns tracing off
+    void SetSampleRate(int rate) { m_sampleRate = rate < 0 ? 0 : rate; }
+    int GetSampleRate() const { return m_sampleRate; }
+
+    // Name the calling thread "game thread" in exports
+    void SetMainThread() { m_mainThread = CurrentThread(); }
+
+    // Decide whether the trace about to make its first request is kept
+    bool Sample();
+    void Submit(Trace&& trace);
+
+    // Write the buffered traces as Chrome trace-event JSON.
+    // Returns false with error set if the file cannot be written.
+    bool ExportChromeTrace(const std::string& path, size_t& exported, std::string& error) const;
+
+    Stats GetStats() const;
+    void Clear();
+
+    static int64_t NowUs();
+
+    // Small id of the calling thread, stable for its lifetime
+    static uint32_t CurrentThread();
+
+private:
+    std::atomic<int> m_sampleRate;
+    std::atomic<uint64_t> m_seen;
+    std::atomic<uint64_t> m_sampled;
+    std::atomic<uint32_t> m_mainThread;
+
+    mutable std::mutex m_mutex;     // guards the ring
+    std::vector<Trace> m_traces;
+    size_t m_capacity;
+    size_t m_next;
+};
+
+// Traces of the extension; thread-safe
+extern RequestTracer g_requestTracer;
+
+// Collects the requests made on the calling thread while it lives into one
+// trace. A scope opened while another is active on the thread joins the
+// outer one. Sampling is decided at the first request, so a scope around
+// work that sends nothing costs a clock read.
+class RequestTraceScope
+{
+public:
+    explicit RequestTraceScope(const char* origin, int64_t queuedUs = 0);
+
+    // Collect the requests of a worker thread into parent's trace, for work a
+    // traced call fans out to threads and waits for. parent is Current() of
+    // the handing thread, may be null and must outlive this scope.
+    explicit RequestTraceScope(RequestTraceScope* parent);
+    ~RequestTraceScope();
+
+    // Scope of the calling thread, or null
+    static RequestTraceScope* Current();
+
+    RequestTraceScope(const RequestTraceScope&) = delete;
+    RequestTraceScope& operator=(const RequestTraceScope&) = delete;
+
+    // Called by the transports around curl_easy_perform. BeginRequest returns
+    // the send time to pass to EndRequest, or 0 if the request is not traced;
+    // curl is the easy handle (CURL*) to read the phase times from.
+    static int64_t BeginRequest();
+    static void EndRequest(int64_t sendUs, void* curl, const char* url, long statusCode, bool transferred,
+                           size_t requestBytes, size_t responseBytes);
+
+private:
+    // Scope that owns the trace: this one, or the parent of a worker's scope
+    RequestTraceScope* Root();
+
+    bool m_owner;                   // outermost scope of the thread
+    RequestTraceScope* m_parent;    // set on worker threads
+    std::mutex m_mutex;             // guards the fields below once workers join
+    bool m_decided;
+    bool m_sampled;
+    RequestTracer::Trace m_trace;
+};
+
+#endif // _REQUEST_TRACE_H_
@@ -0,0 +1,394 @@
+/**
+ * MongoDB Extension Shared Memory Cache Implementation
+ *
+ * Layout: a header with per-collection generation counters followed by
+ * fixed-size slots in an open-addressed hash table. Each slot is guarded by
+ * a seqlock: writers move the sequence to an odd value with a CAS (and skip
+ * the write if another process holds it), readers retry if the sequence
+ * changed while they copied the slot. Nothing ever blocks on another process.
+ */
+
+#include "shm_cache.h"
+#include "file_utils.h"
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <chrono>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static const uint32_t SHM_MAGIC = 0x4D474443; // "MGDC"
+static const uint32_t SHM_VERSION = 1;
+static const size_t GENERATION_BUCKETS = 1024;
+static const size_t PROBE_LIMIT = 8;
+static const int READ_RETRIES = 4;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared memory cache needs lock-free 32-bit atomics");
+
+struct SharedDocumentCache::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> generations[GENERATION_BUCKETS];
+};
+
+struct SharedDocumentCache::Slot
+{
+    std::atomic<uint32_t> seq; // odd while a writer owns the slot
+    uint32_t keyHash;
+    uint32_t generation;
+    uint32_t found;
+    int64_t expires; // unix time, 0 = empty
+    uint32_t keyLength;
+    uint32_t valueLength;
+    // key bytes, then value bytes
+};
+
+SharedDocumentCache::SharedDocumentCache()
+    : m_base(nullptr)
+    , m_mappedSize(0)
+    , m_slotCount(0)
+    , m_slotSize(0)
+{
+}
+
+SharedDocumentCache::~SharedDocumentCache()
+{
+    Close();
+}
+
+#ifndef WIN32
+
+bool SharedDocumentCache::Open(const std::string& name, size_t sizeBytes, size_t slotSize)
+{
+    Close();
+
+    slotSize = (slotSize + 7) & ~static_cast<size_t>(7);
+    if (slotSize <= sizeof(Slot) || sizeBytes <= sizeof(Header) + slotSize)
+    {
+        m_lastError = "Shared cache size is too small";
+        return false;
+    }
+
+    size_t slotCount = (sizeBytes - sizeof(Header)) / slotSize;
+    size_t totalSize = sizeof(Header) + slotCount * slotSize;
+
+    bool created = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+    {
+        created = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        m_lastError = std::string("shm_open failed: ") + strerror(errno);
+        return false;
+    }
+
+    if (created)
+    {
+        if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0)
+        {
+            m_lastError = std::string("ftruncate failed: ") + strerror(errno);
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+    }
+    else
+    {
+        // Another instance created the segment; wait for it to be sized
+        struct stat st;
+        for (int i = 0; i < 100; i++)
+        {
+            if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > sizeof(Header))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= sizeof(Header))
+        {
+            m_lastError = "Existing shared cache segment is not initialized";
+            close(fd);
+            return false;
+        }
+        totalSize = static_cast<size_t>(st.st_size);
+    }
+
+    void* base = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        m_lastError = std::string("mmap failed: ") + strerror(errno);
+        return false;
+    }
+
+    Header* header = static_cast<Header*>(base);
+    if (created)
+    {
+        // ftruncate zero-fills, so every slot starts empty
+        header->magic = SHM_MAGIC;
+        header->version = SHM_VERSION;
+        header->slotCount = static_cast<uint32_t>(slotCount);
+        header->slotSize = static_cast<uint32_t>(slotSize);
+        header->ready.store(1, std::memory_order_release);
+    }
+    else
+    {
+        for (int i = 0; i < 100 && header->ready.load(std::memory_order_acquire) == 0; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (header->ready.load(std::memory_order_acquire) == 0 || header->magic != SHM_MAGIC ||
+            header->version != SHM_VERSION ||
+            sizeof(Header) + static_cast<size_t>(header->slotCount) * header->slotSize > totalSize)
+        {
+            m_lastError = "Existing shared cache segment has an incompatible layout";
+            munmap(base, totalSize);
+            return false;
+        }
+        slotCount = header->slotCount;
+        slotSize = header->slotSize;
+    }
+
+    m_base = base;
+    m_mappedSize = totalSize;
+    m_slotCount = slotCount;
+    m_slotSize = slotSize;
+    m_lastError.clear();
+    return true;
+}
+
+void SharedDocumentCache::Close()
+{
+    // The segment is left in place for the other instances on the host
+    if (m_base)
+    {
+        munmap(m_base, m_mappedSize);
+    }
+    m_base = nullptr;
+    m_mappedSize = 0;
+    m_slotCount = 0;
+    m_slotSize = 0;
+}
+
+#else
+
+bool SharedDocumentCache::Open(const std::string& name, size_t sizeBytes, size_t slotSize)
+{
+    m_lastError = "Shared cache is only supported on Linux";
+    return false;
+}
+
+void SharedDocumentCache::Close()
+{
+}
+
+#endif
+
+SharedDocumentCache::Slot* SharedDocumentCache::SlotAt(size_t index) const
+{
+    char* slots = static_cast<char*>(m_base) + sizeof(Header);
+    return reinterpret_cast<Slot*>(slots + index * m_slotSize);
+}
+
+std::atomic<uint32_t>* SharedDocumentCache::GenerationFor(const std::string& collectionKey) const
+{
+    Header* header = static_cast<Header*>(m_base);
+    return &header->generations[Fnv1a(collectionKey.data(), collectionKey.length()) % GENERATION_BUCKETS];
+}
+
+std::string SharedDocumentCache::MakeKey(const std::string& collectionKey, const std::string& filterJson) const
+{
+    // Hash the collection key so connection strings never land in shared memory
+    char prefix[24];
+    snprintf(prefix, sizeof(prefix), "%016llx|",
+             static_cast<unsigned long long>(Fnv1a(collectionKey.data(), collectionKey.length())));
+    return prefix + filterJson;
+}
+
+uint32_t SharedDocumentCache::GetGeneration(const std::string& collectionKey) const
+{
+    if (!m_base)
+        return 0;
+    return GenerationFor(collectionKey)->load(std::memory_order_acquire);
+}
+
+bool SharedDocumentCache::ReadSlot(Slot* slot, uint32_t keyHash, const std::string& key,
+                                   std::string& value, bool& found, int64_t& expires, uint32_t& generation) const
+{
+    const char* data = reinterpret_cast<const char*>(slot) + sizeof(Slot);
+    size_t capacity = m_slotSize - sizeof(Slot);
+
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++)
+    {
+        uint32_t before = slot->seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue; // a writer is in the slot
+
+        uint32_t slotHash = slot->keyHash;
+        uint32_t keyLength = slot->keyLength;
+        uint32_t valueLength = slot->valueLength;
+        int64_t slotExpires = slot->expires;
+        uint32_t slotGeneration = slot->generation;
+        uint32_t slotFound = slot->found;
+
+        if (slotExpires == 0 || slotHash != keyHash || keyLength != key.length() ||
+            static_cast<size_t>(keyLength) + valueLength > capacity)
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) == before)
+                return false;
+            continue;
+        }
+
+        bool keyMatches = memcmp(data, key.data(), keyLength) == 0;
+        std::string copy(data + keyLength, valueLength);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) != before)
+            continue; // torn read, try again
+
+        if (!keyMatches)
+            return false;
+
+        value.swap(copy);
+        found = slotFound != 0;
+        expires = slotExpires;
+        generation = slotGeneration;
+        return true;
+    }
+    return false;
+}
+
+bool SharedDocumentCache::Get(const std::string& collectionKey, const std::string& filterJson,
+                              std::string& documentJson, bool& found)
+{
+    if (!m_base)
+        return false;
+
+    std::string key = MakeKey(collectionKey, filterJson);
+    uint64_t hash = Fnv1a(key.data(), key.length());
+    uint32_t keyHash = static_cast<uint32_t>(hash >> 32);
+    uint32_t currentGeneration = GetGeneration(collectionKey);
+    int64_t now = static_cast<int64_t>(time(nullptr));
+
+    for (size_t probe = 0; probe < PROBE_LIMIT; probe++)
+    {
+        Slot* slot = SlotAt((hash + probe) % m_slotCount);
+
+        std::string value;
+        bool slotFound;
+        int64_t expires;
+        uint32_t generation;
+        if (!ReadSlot(slot, keyHash, key, value, slotFound, expires, generation))
+            continue;
+
+        if (expires <= now || generation != currentGeneration)
+            return false; // stale, a later Put will reuse the slot
+
+        documentJson.swap(value);
+        found = slotFound;
+        return true;
+    }
+    return false;
+}
+
+void SharedDocumentCache::Put(const std::string& collectionKey, uint32_t generation, const std::string& filterJson,
+                              const std::string& documentJson, bool found, int ttlSeconds)
+{
+    if (!m_base || ttlSeconds <= 0)
+        return;
+
+    std::string key = MakeKey(collectionKey, filterJson);
+    size_t valueLength = found ? documentJson.length() : 0;
+    if (key.length() + valueLength > m_slotSize - sizeof(Slot))
+        return; // does not fit in a slot
+
+    uint64_t hash = Fnv1a(key.data(), key.length());
+    uint32_t keyHash = static_cast<uint32_t>(hash >> 32);
+    uint32_t currentGeneration = GetGeneration(collectionKey);
+    if (generation != currentGeneration)
+        return; // invalidated while the request was in flight
+
+    int64_t now = static_cast<int64_t>(time(nullptr));
+
+    // Prefer the slot holding this key, then a free or stale one, then the oldest
+    Slot* target = nullptr;
+    Slot* fallback = nullptr;
+    int64_t oldestExpires = 0;
+    for (size_t probe = 0; probe < PROBE_LIMIT && !target; probe++)
+    {
+        Slot* slot = SlotAt((hash + probe) % m_slotCount);
+
+        std::string value;
+        bool slotFound;
+        int64_t expires;
+        uint32_t slotGeneration;
+        if (ReadSlot(slot, keyHash, key, value, slotFound, expires, slotGeneration))
+        {
+            target = slot;
+            break;
+        }
+
+        int64_t slotExpires = slot->expires;
+        if (slotExpires <= now)
+        {
+            target = slot;
+        }
+        else if (!fallback || slotExpires < oldestExpires)
+        {
+            fallback = slot;
+            oldestExpires = slotExpires;
+        }
+    }
+    if (!target)
+        target = fallback;
+
+    uint32_t seq = target->seq.load(std::memory_order_relaxed);
+    if ((seq & 1) || !target->seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+        return; // another process is writing this slot; it is only a cache
+
+    char* data = reinterpret_cast<char*>(target) + sizeof(Slot);
+    memcpy(data, key.data(), key.length());
+    if (valueLength)
+        memcpy(data + key.length(), documentJson.data(), valueLength);
+
+    target->keyHash = keyHash;
+    target->keyLength = static_cast<uint32_t>(key.length());
+    target->valueLength = static_cast<uint32_t>(valueLength);
+    target->generation = generation;
+    target->found = found ? 1 : 0;
+    target->expires = now + ttlSeconds;
+
+    target->seq.store(seq + 2, std::memory_order_release);
+}
+
+void SharedDocumentCache::InvalidateCollection(const std::string& collectionKey)
+{
+    if (m_base)
+        GenerationFor(collectionKey)->fetch_add(1, std::memory_order_acq_rel);
+}
+
+void SharedDocumentCache::InvalidateAll()
+{
+    if (!m_base)
+        return;
+
+    Header* header = static_cast<Header*>(m_base);
+    for (size_t i = 0; i < GENERATION_BUCKETS; i++)
+    {
+        header->generations[i].fetch_add(1, std::memory_order_acq_rel);
+    }
+}
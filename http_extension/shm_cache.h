@@ -0,0 +1,61 @@
+/**
+ * MongoDB Extension Shared Memory Cache
+ * Host-wide document cache tier shared by every extension instance on the
+ * machine through a POSIX shared memory segment
+ */
+
+#ifndef _SHM_CACHE_H_
+#define _SHM_CACHE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+class SharedDocumentCache
+{
+public:
+    SharedDocumentCache();
+    ~SharedDocumentCache();
+
+    // Create or attach to the named segment. Instances that attach to an
+    // existing segment use its geometry, not the requested one.
+    bool Open(const std::string& name, size_t sizeBytes, size_t slotSize);
+    void Close();
+    bool IsOpen() const { return m_base != nullptr; }
+
+    // Per-collection generation; read it before a request and pass it to Put
+    uint32_t GetGeneration(const std::string& collectionKey) const;
+
+    bool Get(const std::string& collectionKey, const std::string& filterJson,
+             std::string& documentJson, bool& found);
+    void Put(const std::string& collectionKey, uint32_t generation, const std::string& filterJson,
+             const std::string& documentJson, bool found, int ttlSeconds);
+
+    // Invalidation is per collection for every instance on the host
+    void InvalidateCollection(const std::string& collectionKey);
+    void InvalidateAll();
+
+    size_t GetSlotCount() const { return m_slotCount; }
+    size_t GetSlotSize() const { return m_slotSize; }
+    size_t GetMappedSize() const { return m_mappedSize; }
+    const std::string& GetLastError() const { return m_lastError; }
+
+private:
+    struct Header;
+    struct Slot;
+
+    Slot* SlotAt(size_t index) const;
+    std::atomic<uint32_t>* GenerationFor(const std::string& collectionKey) const;
+    std::string MakeKey(const std::string& collectionKey, const std::string& filterJson) const;
+    bool ReadSlot(Slot* slot, uint32_t keyHash, const std::string& key,
+                  std::string& value, bool& found, int64_t& expires, uint32_t& generation) const;
+
+    void* m_base;
+    size_t m_mappedSize;
+    size_t m_slotCount;
+    size_t m_slotSize;
+    std::string m_lastError;
+};
+
+#endif // _SHM_CACHE_H_
@@ -0,0 +1,266 @@
+/**
+ * MongoDB Extension Slow-Query Log Implementation
+ */
+
+#include "slow_query_log.h"
+#include "json_utils.h"
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+// Entries waiting for the writer before Record drops new ones
+static const size_t SLOW_QUERY_MAX_PENDING = 10000;
+
+SlowQueryLog::SlowQueryLog()
+    : m_thresholdUs(-1)
+    , m_stop(false)
+    , m_reopen(false)
+    , m_fileOpen(false)
+    , m_maxBytes(0)
+    , m_backups(0)
+    , m_file(nullptr)
+    , m_size(0)
+    , m_logged(0)
+    , m_dropped(0)
+    , m_rotations(0)
+{
+}
+
+SlowQueryLog::~SlowQueryLog()
+{
+    Stop();
+}
+
+bool SlowQueryLog::Open(const std::string& path, size_t maxBytes, int backups)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop)
+        return false;
+
+    m_path = path;
+    m_maxBytes = maxBytes;
+    m_backups = backups;
+    m_reopen = true;
+    if (!m_thread.joinable())
+        m_thread = std::thread(&SlowQueryLog::Run, this);
+    m_wake.notify_one();
+    return true;
+}
+
+void SlowQueryLog::Record(Entry&& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop || !m_thread.joinable() || m_queue.size() >= SLOW_QUERY_MAX_PENDING)
+    {
+        m_dropped++;
+        return;
+    }
+    m_queue.push_back(std::move(entry));
+    m_wake.notify_one();
+}
+
+void SlowQueryLog::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_wake.notify_one();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+std::string SlowQueryLog::RedactValues(const std::string& json)
+{
+    size_t pos = JsonSkipWhitespace(json, 0);
+    if (pos >= json.length())
+        return "\"?\"";
+
+    if (json[pos] == '{')
+    {
+        std::vector<std::pair<std::string, std::string>> members;
+        if (!JsonSplitObject(json, members))
+            return "\"?\"";
+        std::string shape = "{";
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            if (i > 0)
+                shape += ",";
+            shape += members[i].first + ":" + RedactValues(members[i].second);
+        }
+        return shape + "}";
+    }
+
+    if (json[pos] == '[')
+    {
+        // Lists of values ($in, $all) collapse to one placeholder whatever their
+        // length; lists of clauses ($and, $or, pipelines) keep their structure
+        std::vector<std::string> elements;
+        if (!JsonSplitArray(json, elements))
+            return "[\"?\"]";
+        std::string shape = "[";
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            size_t first = JsonSkipWhitespace(elements[i], 0);
+            bool nested = first < elements[i].length() && (elements[i][first] == '{' || elements[i][first] == '[');
+            if (!nested)
+                return "[\"?\"]";
+            if (i > 0)
+                shape += ",";
+            shape += RedactValues(elements[i]);
+        }
+        return shape + "]";
+    }
+
+    return "\"?\"";
+}
+
+std::string SlowQueryLog::QueryShape(const std::string& body)
+{
+    std::string query;
+    if (JsonGetMember(body, "filter", query) || JsonGetMember(body, "pipeline", query))
+        return RedactValues(query);
+    return "";
+}
+
+std::string SlowQueryLog::Format(const Entry& entry) const
+{
+    char time[32];
+    struct tm local;
+#ifdef WIN32
+    localtime_s(&local, &entry.time);
+#else
+    localtime_r(&entry.time, &local);
+#endif
+    strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", &local);
+
+    char duration[32];
+    snprintf(duration, sizeof(duration), "%.3f", entry.micros / 1000.0);
+
+    std::string line = std::string("{\"time\":\"") + time + "\",\"op\":\"" + entry.operation + "\"";
+    if (!entry.collection.empty())
+        line += ",\"collection\":" + JsonQuote(entry.collection);
+    line += std::string(",\"ms\":") + duration + ",\"responseBytes\":" + std::to_string(entry.responseBytes) +
+            ",\"success\":" + (entry.success ? "true" : "false");
+    if (!entry.plugin.empty())
+        line += ",\"plugin\":" + JsonQuote(entry.plugin);
+    std::string shape = QueryShape(entry.body);
+    if (!shape.empty())
+        line += ",\"shape\":" + shape;
+    return line + "}\n";
+}
+
+bool SlowQueryLog::Rotate(const std::string& path, int backups)
+{
+    fclose(m_file);
+    m_file = nullptr;
+
+    if (backups > 0)
+    {
+        // path.N-1 -> path.N, ..., path -> path.1; the oldest is replaced
+        for (int i = backups; i > 0; i--)
+        {
+            std::string from = i == 1 ? path : path + "." + std::to_string(i - 1);
+            std::string to = path + "." + std::to_string(i);
+#ifdef WIN32
+            remove(to.c_str());
+#endif
+            rename(from.c_str(), to.c_str());
+        }
+    }
+
+    m_file = fopen(path.c_str(), "wb");
+    m_size = 0;
+    return m_file != nullptr;
+}
+
+void SlowQueryLog::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this]() { return m_stop || m_reopen || !m_queue.empty(); });
+
+        std::deque<Entry> entries;
+        entries.swap(m_queue);
+        bool reopen = m_reopen;
+        m_reopen = false;
+        bool stop = m_stop;
+        std::string path = m_path;
+        size_t maxBytes = m_maxBytes;
+        int backups = m_backups;
+        lock.unlock();
+
+        std::string error;
+        if (reopen)
+        {
+            if (m_file)
+                fclose(m_file);
+            m_file = fopen(path.c_str(), "ab");
+            m_size = m_file ? (size_t)ftell(m_file) : 0;
+            if (!m_file)
+                error = "Cannot open " + path + ": " + strerror(errno);
+        }
+
+        uint64_t logged = 0, rotations = 0;
+        for (const Entry& entry : entries)
+        {
+            if (!m_file)
+                break;
+            std::string line = Format(entry);
+            if (m_size > 0 && m_size + line.length() > maxBytes)
+            {
+                rotations++;
+                if (!Rotate(path, backups))
+                {
+                    error = "Cannot rotate " + path + ": " + strerror(errno);
+                    break;
+                }
+            }
+            if (fwrite(line.data(), line.length(), 1, m_file) != 1)
+            {
+                error = "Cannot write " + path;
+                break;
+            }
+            m_size += line.length();
+            logged++;
+        }
+        if (m_file)
+            fflush(m_file);
+
+        lock.lock();
+        m_fileOpen = m_file != nullptr;
+        m_logged += logged;
+        m_dropped += entries.size() - logged;
+        m_rotations += rotations;
+        if (!error.empty())
+            m_lastError = error;
+        if (stop && m_queue.empty())
+            break;
+    }
+
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+SlowQueryLog::Stats SlowQueryLog::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = { m_fileOpen, m_thresholdUs, m_logged, m_dropped, m_rotations };
+    return stats;
+}
+
+std::string SlowQueryLog::GetPath() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_path;
+}
+
+std::string SlowQueryLog::GetLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
@@ -0,0 +1,100 @@
+/**
+ * MongoDB Extension Slow-Query Log
+ * Operations that took longer than a threshold, one JSON object per line,
+ * written to a size-rotated file by a background thread
+ */
+
+#ifndef _SLOW_QUERY_LOG_H_
+#define _SLOW_QUERY_LOG_H_
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <ctime>
+#include <cstdint>
+#include <cstdio>
+
+class SlowQueryLog
+{
+public:
+    struct Entry
+    {
+        time_t time;
+        const char* operation;  // static string
+        std::string collection; // "db/collection", empty for batches
+        std::string plugin;     // calling plugin's filename, if known
+        std::string body;       // request body; only its query shape is written
+        uint64_t micros;
+        size_t responseBytes;
+        bool success;
+    };
+
+    struct Stats
+    {
+        bool open;
+        int64_t thresholdUs;
+        uint64_t logged;
+        uint64_t dropped;       // entries refused because the queue was full
+        uint64_t rotations;
+    };
+
+    SlowQueryLog();
+    ~SlowQueryLog();
+
+    // Write to path, starting over once the file reaches maxBytes: with
+    // backups > 0 the file is renamed to path.1 (path.1 to path.2, ...) first,
+    // otherwise it is truncated. Starts the writer thread.
+    bool Open(const std::string& path, size_t maxBytes, int backups);
+
+    // Log operations that take at least micros; negative turns logging off
+    void SetThreshold(int64_t micros) { m_thresholdUs = micros; }
+    bool IsSlow(uint64_t micros) const
+    {
+        int64_t threshold = m_thresholdUs;
+        return threshold >= 0 && micros >= (uint64_t)threshold;
+    }
+
+    // Queue an entry; any thread
+    void Record(Entry&& entry);
+
+    // Write what is queued and stop the thread (extension unload)
+    void Stop();
+
+    // The filter (or pipeline) of a request body with every value replaced by
+    // "?", so queries that differ only in their values look the same
+    static std::string QueryShape(const std::string& body);
+
+    Stats GetStats() const;
+    std::string GetPath() const;
+    std::string GetLastError() const;
+
+private:
+    static std::string RedactValues(const std::string& json);
+    std::string Format(const Entry& entry) const;
+    bool Rotate(const std::string& path, int backups);
+    void Run();
+
+    std::atomic<int64_t> m_thresholdUs;
+
+    mutable std::mutex m_mutex;         // guards everything below but m_file and m_size
+    std::condition_variable m_wake;
+    std::deque<Entry> m_queue;
+    std::thread m_thread;
+    bool m_stop;
+    bool m_reopen;                      // Open changed the file
+    bool m_fileOpen;
+    std::string m_path;
+    size_t m_maxBytes;
+    int m_backups;
+    FILE* m_file;                       // writer thread only
+    size_t m_size;
+    uint64_t m_logged;
+    uint64_t m_dropped;
+    uint64_t m_rotations;
+    std::string m_lastError;
+};
+
+#endif // _SLOW_QUERY_LOG_H_
@@ -0,0 +1,389 @@
+/**
+ * MongoDB Extension Snapshot Store Implementation
+ *
+ * File layout (host byte order):
+ *   Header, version bytes, then per document:
+ *   uint32 filter length, uint32 document length, filter bytes, document bytes
+ *
+ * The revalidation thread never calls into SourceMod; it only talks to the
+ * API service, the snapshot files and the (thread-safe) DocumentCache.
+ */
+
+#include "snapshot_store.h"
+#include "document_cache.h"
+#include "json_utils.h"
+#include "http_transport.h"
+#include "file_utils.h"
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <set>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[4] = { 'M', 'G', 'S', 'N' };
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+// Snapshots are meant for small reference collections
+static const size_t SNAPSHOT_MAX_DOCUMENTS = 10000;
+
+struct SnapshotStore::Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t documentCount; // entries in the file
+    uint32_t totalCount;    // documents in the collection
+    uint32_t versionLength;
+    uint32_t reserved;
+    int64_t savedAt;
+    uint64_t checksum;      // FNV-1a of everything after the header
+};
+
+// Read-only view of a whole file; mapped where the platform allows it
+class SnapshotStore::MappedFile
+{
+public:
+    MappedFile() : m_data(nullptr), m_size(0), m_mapped(false) {}
+    ~MappedFile()
+    {
+#ifndef WIN32
+        if (m_mapped)
+            munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+
+    bool Open(const std::string& path)
+    {
+#ifndef WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        void* base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+            return false;
+
+        m_data = static_cast<const char*>(base);
+        m_size = static_cast<size_t>(st.st_size);
+        m_mapped = true;
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        m_buffer.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+        return m_size > 0;
+#endif
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::string m_buffer;
+};
+
+SnapshotStore::SnapshotStore(DocumentCache& cache)
+    : m_cache(cache)
+    , m_stop(false)
+{
+}
+
+SnapshotStore::~SnapshotStore()
+{
+    Stop();
+}
+
+void SnapshotStore::SetDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+}
+
+std::string SnapshotStore::SnapshotPath(const Request& request) const
+{
+    // Hash the cache key so connection strings never end up in file names
+    std::string id = request.collectionKey + "|" + request.keyField;
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.snap",
+             static_cast<unsigned long long>(Fnv1a(id.data(), id.length())));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_directory + "/" + name;
+}
+
+int SnapshotStore::Load(const Request& request)
+{
+    std::string id = request.collectionKey + "|" + request.keyField;
+    std::string path = SnapshotPath(request);
+
+    State state = { 0, "", false, false };
+    int loaded = 0;
+
+    MappedFile file;
+    if (file.Open(path))
+    {
+        std::vector<std::pair<std::string, std::string>> documents;
+        if (!ReadSnapshot(file, state, documents))
+        {
+            // Rewritten by the revalidation below
+            state = { 0, "", false, false };
+            m_lastError = "Snapshot file is corrupt: " + path;
+            loaded = -1;
+        }
+        else
+        {
+            DocumentCache::Generation generation = m_cache.GetGeneration(request.collectionKey);
+            if (m_cache.Replace(request.collectionKey, generation, documents))
+            {
+                state.loaded = true;
+                loaded = static_cast<int>(documents.size());
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[id] = state;
+
+    bool queued = false;
+    for (const Request& pending : m_queue)
+    {
+        if (pending.collectionKey == request.collectionKey && pending.keyField == request.keyField)
+            queued = true;
+    }
+    if (!queued)
+        m_queue.push_back(request);
+
+    if (!m_thread.joinable() && !m_stop)
+        m_thread = std::thread(&SnapshotStore::Run, this);
+    m_wake.notify_one();
+
+    return loaded;
+}
+
+bool SnapshotStore::IsValidated(const std::string& collectionKey, const std::string& keyField) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(collectionKey + "|" + keyField);
+    return it != m_states.end() && it->second.validated;
+}
+
+void SnapshotStore::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool SnapshotStore::ReadSnapshot(const MappedFile& file, State& state,
+                                 std::vector<std::pair<std::string, std::string>>& documents)
+{
+    const char* data = file.Data();
+    size_t size = file.Size();
+    if (size < sizeof(Header))
+        return false;
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION)
+        return false;
+
+    const char* body = data + sizeof(Header);
+    size_t bodySize = size - sizeof(Header);
+    if (Fnv1a(body, bodySize) != header.checksum || header.versionLength > bodySize)
+        return false;
+
+    state.totalCount = header.totalCount;
+    state.version.assign(body, header.versionLength);
+
+    size_t pos = header.versionLength;
+    documents.reserve(header.documentCount);
+    for (uint32_t i = 0; i < header.documentCount; i++)
+    {
+        uint32_t lengths[2];
+        if (bodySize - pos < sizeof(lengths))
+            return false;
+        memcpy(lengths, body + pos, sizeof(lengths));
+        pos += sizeof(lengths);
+
+        if (bodySize - pos < static_cast<size_t>(lengths[0]) + lengths[1])
+            return false;
+        documents.emplace_back(std::string(body + pos, lengths[0]), std::string(body + pos + lengths[0], lengths[1]));
+        pos += static_cast<size_t>(lengths[0]) + lengths[1];
+    }
+    return pos == bodySize;
+}
+
+bool SnapshotStore::WriteSnapshot(const std::string& path, const State& state,
+                                  const std::vector<std::pair<std::string, std::string>>& documents)
+{
+    std::string body = state.version;
+    for (const auto& document : documents)
+    {
+        uint32_t lengths[2] = { static_cast<uint32_t>(document.first.length()),
+                                static_cast<uint32_t>(document.second.length()) };
+        body.append(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+        body += document.first;
+        body += document.second;
+    }
+
+    Header header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.documentCount = static_cast<uint32_t>(documents.size());
+    header.totalCount = state.totalCount;
+    header.versionLength = static_cast<uint32_t>(state.version.length());
+    header.reserved = 0;
+    header.savedAt = static_cast<int64_t>(time(nullptr));
+    header.checksum = Fnv1a(body.data(), body.length());
+
+    // Write next to the old file and swap, so a crash never leaves a torn snapshot
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        file.write(body.data(), body.length());
+        if (!file.good())
+            return false;
+    }
+
+#ifdef WIN32
+    remove(path.c_str());
+#endif
+    return rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+void SnapshotStore::Run()
+{
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_stop)
+                return;
+
+            request = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        Revalidate(request);
+    }
+}
+
+void SnapshotStore::Revalidate(const Request& request)
+{
+    std::string id = request.collectionKey + "|" + request.keyField;
+    State current;
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        current = m_states[id];
+        directory = m_directory;
+    }
+
+    // Cheap check first: document count and, if configured, the highest version
+    std::string countData, countValue;
+    if (!HttpServicePostData(request.countUrl, "{\"filter\":{}}", request.apiKey, countData, &m_stop) ||
+        !JsonGetMember(countData, "count", countValue))
+    {
+        return; // service unreachable, keep serving the snapshot
+    }
+
+    std::string version;
+    if (!request.versionField.empty())
+    {
+        std::string newest;
+        std::vector<std::string> newestDocs;
+        std::string body = "{\"filter\":{},\"options\":{\"sort\":" + request.versionSort + ",\"limit\":1}}";
+        if (!HttpServicePostData(request.findUrl, body, request.apiKey, newest, &m_stop) ||
+            !JsonSplitArray(newest, newestDocs))
+        {
+            return;
+        }
+        if (!newestDocs.empty())
+            JsonGetPath(newestDocs[0], request.versionField, version);
+        version = JsonCompact(version);
+    }
+
+    uint32_t totalCount = static_cast<uint32_t>(strtoul(countValue.c_str(), nullptr, 10));
+    if (current.loaded && current.totalCount == totalCount && current.version == version)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_states[id].validated = true;
+        return;
+    }
+
+    if (totalCount > SNAPSHOT_MAX_DOCUMENTS)
+    {
+        return; // not a reference collection; FindOne keeps using the network
+    }
+
+    // Changed or never snapshotted: fetch the whole collection
+    DocumentCache::Generation generation = m_cache.GetGeneration(request.collectionKey);
+
+    std::string dataArray;
+    std::vector<std::string> fetched;
+    std::string body = "{\"filter\":{},\"options\":{\"limit\":" + std::to_string(SNAPSHOT_MAX_DOCUMENTS) + "}}";
+    if (!HttpServicePostData(request.findUrl, body, request.apiKey, dataArray, &m_stop) ||
+        !JsonSplitArray(dataArray, fetched))
+    {
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> documents;
+    std::set<std::string> seen;
+    for (const std::string& document : fetched)
+    {
+        std::string keyValue;
+        if (!JsonGetPath(document, request.keyField, keyValue) || keyValue.empty() ||
+            keyValue[0] == '[' || keyValue[0] == '{')
+        {
+            continue; // No single equality key to cache this document under
+        }
+
+        // FindOne returns the first match, so keep the first document per key
+        std::string filterJson = request.filterPrefix + JsonCompact(keyValue) + "}";
+        if (seen.insert(filterJson).second)
+            documents.emplace_back(filterJson, JsonCompact(document));
+    }
+
+    // A write raced the fetch; try again on the next load
+    if (!m_cache.Replace(request.collectionKey, generation, documents))
+        return;
+
+    State refreshed = { totalCount, version, true, true };
+    if (CreateDirectories(directory))
+        WriteSnapshot(SnapshotPath(request), refreshed, documents);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[id] = refreshed;
+}
@@ -0,0 +1,92 @@
+/**
+ * MongoDB Extension Snapshot Store
+ * Persistent on-disk snapshots of small reference collections. A snapshot is
+ * memory-mapped into the document cache at startup and revalidated against
+ * the API service in the background.
+ */
+
+#ifndef _SNAPSHOT_STORE_H_
+#define _SNAPSHOT_STORE_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <utility>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class DocumentCache;
+
+class SnapshotStore
+{
+public:
+    // Everything the background revalidation needs; built on the game thread
+    struct Request
+    {
+        std::string collectionKey; // document cache key of the collection
+        std::string keyField;      // documents are cached under { keyField: value }
+        std::string filterPrefix;  // escaped '{"keyField":' used to build cache filters
+        std::string versionField;  // optional field whose highest value marks a change
+        std::string versionSort;   // '{"versionField":-1}' when versionField is set
+        std::string findUrl;
+        std::string countUrl;
+        std::string apiKey;
+    };
+
+    explicit SnapshotStore(DocumentCache& cache);
+    ~SnapshotStore();
+
+    // Directory holding the snapshot files; created on first use
+    void SetDirectory(const std::string& directory);
+
+    // Load the snapshot of a collection into the cache (if one exists) and
+    // queue a background revalidation. Returns the number of documents
+    // loaded from disk, or -1 if the snapshot file is unreadable.
+    int Load(const Request& request);
+
+    // True once the background check confirmed or refreshed the snapshot
+    bool IsValidated(const std::string& collectionKey, const std::string& keyField) const;
+
+    // Stop the worker thread (extension unload)
+    void Stop();
+
+    const std::string& GetLastError() const { return m_lastError; }
+
+private:
+    struct Header;
+    class MappedFile;
+
+    struct State
+    {
+        uint32_t totalCount;  // documents in the collection when the snapshot was taken
+        std::string version;  // raw JSON value of the highest versionField
+        bool loaded;
+        bool validated;
+    };
+
+    std::string SnapshotPath(const Request& request) const;
+    bool ReadSnapshot(const MappedFile& file, State& state,
+                      std::vector<std::pair<std::string, std::string>>& documents);
+    bool WriteSnapshot(const std::string& path, const State& state,
+                       const std::vector<std::pair<std::string, std::string>>& documents);
+
+    void Run();
+    void Revalidate(const Request& request);
+
+    DocumentCache& m_cache;
+    std::string m_directory;
+    std::string m_lastError;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, State> m_states; // collection key + key field -> snapshot state
+    std::deque<Request> m_queue;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif // _SNAPSHOT_STORE_H_
@@ -0,0 +1,610 @@
+/**
+ * MongoDB Extension Update Coalescer Implementation
+ */
+
+#include "update_coalescer.h"
+#include "bulk_write.h"
+#include "document_cache.h"
+#include "write_spool.h"
+#include "json_utils.h"
+#include "request_trace.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Updates are refused once this many are waiting for one collection
+static const size_t COALESCE_MAX_PENDING_UPDATES = 100000;
+
+static const char* const OPERATOR_NAMES[] = { "\"$inc\"", "\"$set\"", "\"$max\"", "\"$min\"" };
+
+// Parse a raw JSON number; isInteger is set for plain integers without fraction or exponent
+static bool ParseNumber(const std::string& raw, double& value, bool& isInteger)
+{
+    if (raw.empty())
+        return false;
+
+    char* end;
+    value = strtod(raw.c_str(), &end);
+    if (end != raw.c_str() + raw.length())
+        return false;
+
+    isInteger = raw.find_first_of(".eE") == std::string::npos;
+    return true;
+}
+
+// True if one field path contains the other ("a" and "a.b"); MongoDB rejects
+// an update that touches both, so they must not be merged into one.
+// Paths are quoted JSON names.
+static bool PathsOverlap(const std::string& quotedA, const std::string& quotedB)
+{
+    std::string a = JsonUnquote(quotedA), b = JsonUnquote(quotedB);
+    const std::string& shorter = a.length() < b.length() ? a : b;
+    const std::string& longer = a.length() < b.length() ? b : a;
+    return shorter.length() < longer.length() && longer.compare(0, shorter.length(), shorter) == 0 &&
+           longer[shorter.length()] == '.';
+}
+
+UpdateCoalescer::UpdateCoalescer(DocumentCache& cache)
+    : m_cache(cache)
+    , m_spool(nullptr)
+    , m_helpers(0)
+    , m_stop(false)
+    , m_cancel(false)
+    , m_unknown(0)
+    , m_bytes(0)
+{
+}
+
+UpdateCoalescer::~UpdateCoalescer()
+{
+    Stop(std::chrono::steady_clock::now());
+}
+
+bool UpdateCoalescer::MergeField(Field& field, Operator op, const std::string& value)
+{
+    if (field.op != op)
+        return false;
+
+    if (op == Op_Set)
+    {
+        field.value = value;
+        return true;
+    }
+
+    double current, next;
+    bool currentInteger, nextInteger;
+    if (!ParseNumber(field.value, current, currentInteger) || !ParseNumber(value, next, nextInteger))
+        return false; // e.g. $max of two dates; keep both in order
+
+    if (op == Op_Inc)
+    {
+        if (currentInteger && nextInteger)
+        {
+            field.value = std::to_string(strtoll(field.value.c_str(), nullptr, 10) + strtoll(value.c_str(), nullptr, 10));
+        }
+        else
+        {
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%.17g", current + next);
+            field.value = buffer;
+        }
+    }
+    else if ((op == Op_Max && next > current) || (op == Op_Min && next < current))
+    {
+        field.value = value;
+    }
+    return true;
+}
+
+// Heap bytes of one pending update, counted in its buffer when it is added
+size_t UpdateCoalescer::UpdateBytes(const Update& update)
+{
+    size_t bytes = sizeof(Update);
+    for (const auto& field : update.fields)
+        bytes += sizeof(field) + field.first.capacity() + field.second.value.capacity();
+    return bytes;
+}
+
+std::string UpdateCoalescer::BuildOperation(const std::string& filterJson, const Update& update)
+{
+    std::string groups[Op_Count];
+    for (const auto& entry : update.fields)
+    {
+        std::string& group = groups[entry.second.op];
+        group += group.empty() ? "{" : ",";
+        group += entry.first + ":" + entry.second.value;
+    }
+
+    std::string updateJson;
+    for (int op = 0; op < Op_Count; op++)
+    {
+        if (groups[op].empty())
+            continue;
+        updateJson += updateJson.empty() ? "{" : ",";
+        updateJson += std::string(OPERATOR_NAMES[op]) + ":" + groups[op] + "}";
+    }
+    updateJson += "}";
+
+    return "{\"updateOne\":{\"filter\":" + filterJson + ",\"update\":" + updateJson +
+           ",\"upsert\":" + (update.upsert ? "true" : "false") + "}}";
+}
+
+bool UpdateCoalescer::Add(const Target& target, int flushIntervalMs, const std::string& filterJson,
+                          const std::string& updateJson, bool upsert, std::string& error)
+{
+    // Parse the update into (operator, quoted field, raw value) triples
+    std::vector<std::pair<std::string, std::string>> operators;
+    if (!JsonSplitObject(updateJson, operators) || operators.empty())
+    {
+        error = "update is not a JSON object with update operators";
+        return false;
+    }
+
+    struct Change
+    {
+        Operator op;
+        std::string field;
+        std::string value;
+    };
+    std::vector<Change> changes;
+
+    for (const auto& entry : operators)
+    {
+        int op = 0;
+        while (op < Op_Count && entry.first != OPERATOR_NAMES[op])
+            op++;
+        if (op == Op_Count)
+        {
+            error = "operator " + entry.first + " cannot be coalesced (only $inc, $set, $max and $min)";
+            return false;
+        }
+
+        std::vector<std::pair<std::string, std::string>> fields;
+        if (!JsonSplitObject(entry.second, fields))
+        {
+            error = "value of " + entry.first + " is not a JSON object";
+            return false;
+        }
+
+        for (const auto& field : fields)
+        {
+            double number;
+            bool isInteger;
+            if (op == Op_Inc && !ParseNumber(field.second, number, isInteger))
+            {
+                error = "$inc of " + field.first + " is not a number";
+                return false;
+            }
+            changes.push_back({ static_cast<Operator>(op), field.first, field.second });
+        }
+    }
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop)
+        {
+            error = "extension is unloading";
+            return false;
+        }
+
+        auto found = m_buffers.find(target.collectionKey);
+        if (found == m_buffers.end())
+        {
+            found = m_buffers.emplace(target.collectionKey, Buffer()).first;
+            m_bytes += sizeof(Buffer) + found->first.capacity();
+        }
+        Buffer& buffer = found->second;
+        if (buffer.pending >= COALESCE_MAX_PENDING_UPDATES)
+        {
+            error = "too many pending updates";
+            return false;
+        }
+
+        buffer.target = target;
+        buffer.intervalMs = flushIntervalMs > 0 ? flushIntervalMs : 1;
+
+        // Merge into the document's last pending update if it has the same
+        // upsert flag and every field allows it. A new field must not be a
+        // parent or child path of one already there.
+        size_t bytesBefore = buffer.bytes;
+        auto document = buffer.documents.find(filterJson);
+        if (document == buffer.documents.end())
+        {
+            document = buffer.documents.emplace(filterJson, std::vector<Update>()).first;
+            buffer.bytes += document->first.capacity();
+        }
+        std::vector<Update>& updates = document->second;
+        bool merged = false;
+        if (!updates.empty() && updates.back().upsert == upsert)
+        {
+            Update candidate = updates.back();
+            merged = true;
+            for (const Change& change : changes)
+            {
+                auto it = candidate.fields.find(change.field);
+                if (it != candidate.fields.end())
+                {
+                    merged = MergeField(it->second, change.op, change.value);
+                }
+                else
+                {
+                    for (const auto& existing : candidate.fields)
+                    {
+                        if (PathsOverlap(existing.first, change.field))
+                        {
+                            merged = false;
+                            break;
+                        }
+                    }
+                    if (merged)
+                        candidate.fields[change.field] = { change.op, change.value };
+                }
+                if (!merged)
+                    break;
+            }
+
+            if (merged)
+            {
+                buffer.bytes += UpdateBytes(candidate) - UpdateBytes(updates.back());
+                updates.back() = candidate;
+            }
+        }
+
+        if (!merged)
+        {
+            Update update;
+            update.upsert = upsert;
+            for (const Change& change : changes)
+            {
+                auto it = update.fields.find(change.field);
+                if (it == update.fields.end() || !MergeField(it->second, change.op, change.value))
+                    update.fields[change.field] = { change.op, change.value }; // same field twice in one update: last wins
+            }
+            buffer.bytes += UpdateBytes(update);
+            updates.push_back(update);
+
+            if (buffer.pending++ == 0)
+                buffer.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(buffer.intervalMs);
+        }
+
+        m_bytes += buffer.bytes - bytesBefore;
+        buffer.accepted++;
+        wake = buffer.pending == 1 && !merged;
+
+        if (!m_thread.joinable())
+            m_thread = std::thread(&UpdateCoalescer::Run, this);
+    }
+
+    // The thread sleeps until the earliest deadline; only a new deadline needs to wake it
+    if (wake)
+        m_wake.notify_one();
+    return true;
+}
+
+void UpdateCoalescer::Flush(const std::string& collectionKey)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_buffers)
+        {
+            if ((collectionKey.empty() || entry.first == collectionKey) && entry.second.pending > 0)
+                entry.second.flushNow = true;
+        }
+    }
+    m_wake.notify_one();
+}
+
+// Join the Drain helpers; only called once none is running
+void UpdateCoalescer::JoinHelpersLocked(std::unique_lock<std::mutex>& lock)
+{
+    std::vector<std::thread> helpers;
+    helpers.swap(m_helperThreads);
+    lock.unlock();
+    for (std::thread& helper : helpers)
+        helper.join();
+    lock.lock();
+}
+
+size_t UpdateCoalescer::Drain(std::chrono::steady_clock::time_point deadline, size_t maxParallel)
+{
+    Flush("");
+
+    // Helpers send other collections' batches next to the background thread
+    // until nothing is due or the deadline passes. Without the spool a request
+    // they started runs to its end after Drain returns; Stop joins them then.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_helpers == 0)
+        JoinHelpersLocked(lock); // left over from the last Drain
+    for (size_t i = 1; i < maxParallel; i++)
+    {
+        m_helpers++;
+        m_helperThreads.emplace_back([this, deadline]() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            SendDue(lock, deadline);
+            m_helpers--;
+            m_idle.notify_all();
+        });
+    }
+
+    m_idle.wait_until(lock, deadline, [this]() { return m_sending.empty() && PendingLocked() == 0; });
+
+    // Out of time: journal the rest instead of waiting for it
+    WriteSpool* spool = m_spool;
+    if ((!m_sending.empty() || PendingLocked() > 0) && spool && spool->IsOpen())
+    {
+        m_cancel = true;
+        m_idle.wait(lock, [this]() { return m_sending.empty(); });
+        SpoolDueLocked(lock);
+        m_cancel = false;
+        m_wake.notify_one();
+    }
+
+    if (m_helpers == 0)
+        JoinHelpersLocked(lock);
+    return PendingLocked();
+}
+
+size_t UpdateCoalescer::Stop(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_wake.notify_all();
+    m_idle.wait_until(lock, deadline, [this]() {
+        return m_sending.empty() && m_helpers == 0 && PendingLocked() == 0;
+    });
+
+    // Out of time: abort what is running; the thread takes no more batches
+    m_cancel = true;
+    m_idle.wait(lock, [this]() { return m_sending.empty() && m_helpers == 0; });
+    JoinHelpersLocked(lock);
+    if (m_thread.joinable())
+    {
+        lock.unlock();
+        m_wake.notify_all();
+        m_thread.join();
+        lock.lock();
+    }
+
+    WriteSpool* spool = m_spool;
+    if (spool && spool->IsOpen())
+        SpoolDueLocked(lock);
+
+    size_t dropped = 0;
+    for (auto& entry : m_buffers)
+    {
+        Buffer& buffer = entry.second;
+        dropped += buffer.pending;
+        buffer.failed += buffer.pending;
+        buffer.documents.clear();
+        buffer.pending = 0;
+        m_bytes -= buffer.bytes;
+        buffer.bytes = 0;
+    }
+    if (dropped > 0)
+        m_lastError = "unloading, dropped " + std::to_string(dropped) + " coalesced updates";
+    return dropped;
+}
+
+static UpdateCoalescer::Stats MakeStats(const std::string& key, size_t pending, uint64_t accepted,
+                                        uint64_t sent, uint64_t failed, uint64_t requests)
+{
+    UpdateCoalescer::Stats stats = { key, pending, accepted, sent, failed, requests };
+    return stats;
+}
+
+bool UpdateCoalescer::GetStats(const std::string& collectionKey, Stats& stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_buffers.find(collectionKey);
+    if (it == m_buffers.end())
+        return false;
+
+    const Buffer& buffer = it->second;
+    stats = MakeStats(it->first, buffer.pending, buffer.accepted, buffer.sent, buffer.failed, buffer.requests);
+    return true;
+}
+
+UpdateCoalescer::Stats UpdateCoalescer::GetTotals() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats totals = MakeStats("", 0, 0, 0, 0, 0);
+    for (const auto& entry : m_buffers)
+    {
+        totals.pending += entry.second.pending;
+        totals.accepted += entry.second.accepted;
+        totals.sent += entry.second.sent;
+        totals.failed += entry.second.failed;
+        totals.requests += entry.second.requests;
+    }
+    return totals;
+}
+
+std::vector<UpdateCoalescer::Stats> UpdateCoalescer::GetAllStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Stats> result;
+    for (const auto& entry : m_buffers)
+    {
+        const Buffer& buffer = entry.second;
+        result.push_back(MakeStats(entry.first, buffer.pending, buffer.accepted, buffer.sent, buffer.failed,
+                                   buffer.requests));
+    }
+    return result;
+}
+
+std::string UpdateCoalescer::GetLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+bool UpdateCoalescer::TakeDueLocked(std::chrono::steady_clock::time_point now, Batch& batch)
+{
+    for (auto& entry : m_buffers)
+    {
+        Buffer& buffer = entry.second;
+        if (buffer.pending == 0 || !(m_stop || buffer.flushNow || now >= buffer.deadline) ||
+            m_sending.count(entry.first) > 0)
+            continue;
+
+        // Updates of one document must be applied in order; that only needs an
+        // ordered write when some document has more than one
+        batch.target = buffer.target;
+        batch.operations.clear();
+        batch.ordered = false;
+        for (const auto& document : buffer.documents)
+        {
+            for (const Update& update : document.second)
+                batch.operations.push_back(BuildOperation(document.first, update));
+            batch.ordered = batch.ordered || document.second.size() > 1;
+        }
+
+        buffer.documents.clear();
+        buffer.pending = 0;
+        m_bytes -= buffer.bytes;
+        buffer.bytes = 0;
+        buffer.flushNow = false;
+        return true;
+    }
+    return false;
+}
+
+size_t UpdateCoalescer::PendingLocked() const
+{
+    size_t pending = 0;
+    for (const auto& entry : m_buffers)
+        pending += entry.second.pending;
+    return pending;
+}
+
+// Journal a whole batch without sending it
+void UpdateCoalescer::Spool(Batch& batch)
+{
+    WriteSpool* spool = m_spool;
+    size_t spooled = 0;
+    for (const BulkWriteChunk& chunk : BulkWriteSplit(batch.operations, BULK_WRITE_MAX_OPS, BULK_WRITE_MAX_BYTES))
+    {
+        if (spool && spool->Append(batch.target.bulkWriteUrl, batch.target.mongoUri,
+                                   BulkWriteBody(batch.operations, chunk, batch.ordered)))
+            spooled += chunk.count;
+    }
+
+    if (spooled == batch.operations.size())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers[batch.target.collectionKey].failed += batch.operations.size() - spooled;
+    m_lastError = "write spool is full, dropped " + std::to_string(batch.operations.size() - spooled) +
+                  " coalesced updates";
+}
+
+void UpdateCoalescer::Send(Batch& batch)
+{
+    // While the spool drains, new writes queue up behind the journaled ones
+    WriteSpool* spool = m_spool;
+    if (spool && spool->IsDeferring())
+    {
+        Spool(batch);
+        return;
+    }
+
+    RequestTraceScope trace("coalesced updates");
+    BulkWriteResult result;
+    BulkWriteExecute(batch.target.bulkWriteUrl, batch.target.apiKey, batch.operations, batch.ordered, 1, result,
+                     &m_cancel);
+
+    if (result.failed + result.skipped < batch.operations.size() || result.aborted > 0)
+        m_cache.InvalidateCollection(batch.target.collectionKey);
+    m_unknown += result.aborted;
+
+    // Keep what the service could not take for later; chunks aborted after
+    // sending are not among them (see GetUnknownOutcomes)
+    size_t spooled = 0;
+    for (const BulkWriteChunk& chunk : result.unsent)
+    {
+        if (spool && spool->Append(batch.target.bulkWriteUrl, batch.target.mongoUri,
+                                   BulkWriteBody(batch.operations, chunk, batch.ordered)))
+            spooled += chunk.count;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Buffer& buffer = m_buffers[batch.target.collectionKey];
+    buffer.sent += batch.operations.size() - result.skipped;
+    buffer.failed += result.failed + result.skipped - spooled;
+    buffer.requests += result.requests;
+    if (result.failed + result.skipped > spooled && !result.errors.empty())
+    {
+        const BulkWriteError& first = result.errors.front();
+        m_lastError = std::to_string(result.failed + result.skipped - spooled) + " of " +
+                      std::to_string(batch.operations.size()) + " coalesced updates failed, first: " + first.message;
+    }
+}
+
+// Send batches until none is due, the deadline passes or Drain/Stop cancels;
+// called with the lock held
+void UpdateCoalescer::SendDue(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline)
+{
+    Batch batch;
+    auto now = std::chrono::steady_clock::now();
+    while (!m_cancel && now < deadline && TakeDueLocked(now, batch))
+    {
+        std::string collectionKey = batch.target.collectionKey;
+        m_sending.insert(collectionKey);
+        lock.unlock();
+        Send(batch);
+        lock.lock();
+        m_sending.erase(collectionKey);
+        m_idle.notify_all();
+        m_wake.notify_one(); // updates added meanwhile may be due
+        now = std::chrono::steady_clock::now();
+    }
+}
+
+// Journal every pending update without sending it; called with the lock held
+void UpdateCoalescer::SpoolDueLocked(std::unique_lock<std::mutex>& lock)
+{
+    Batch batch;
+    while (TakeDueLocked(std::chrono::steady_clock::now(), batch))
+    {
+        lock.unlock();
+        Spool(batch);
+        lock.lock();
+    }
+}
+
+void UpdateCoalescer::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        SendDue(lock, std::chrono::steady_clock::time_point::max());
+        auto now = std::chrono::steady_clock::now();
+
+        if (m_stop)
+            return;
+
+        // Drain is journaling the pending updates; wait until it is done
+        if (m_cancel)
+        {
+            m_wake.wait(lock, [this]() { return !m_cancel || m_stop; });
+            continue;
+        }
+
+        // Sleep until the earliest deadline, or until Add/Flush wakes us
+        bool pending = false;
+        auto wakeAt = now + std::chrono::hours(1);
+        for (const auto& entry : m_buffers)
+        {
+            if (entry.second.pending > 0 && entry.second.deadline < wakeAt && m_sending.count(entry.first) == 0)
+            {
+                wakeAt = entry.second.deadline;
+                pending = true;
+            }
+        }
+
+        if (pending)
+            m_wake.wait_until(lock, wakeAt);
+        else
+            m_wake.wait(lock);
+    }
+}
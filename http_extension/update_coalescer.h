@@ -0,0 +1,163 @@
+/**
+ * MongoDB Extension Update Coalescer
+ * Merges repeated $inc/$set/$max/$min updates of the same document and
+ * sends them as one bulk write per interval from a background thread
+ */
+
+#ifndef _UPDATE_COALESCER_H_
+#define _UPDATE_COALESCER_H_
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class DocumentCache;
+class WriteSpool;
+
+class UpdateCoalescer
+{
+public:
+    // Where a collection's merged updates go; built on the game thread
+    struct Target
+    {
+        std::string collectionKey; // document cache key of the collection
+        std::string bulkWriteUrl;
+        std::string apiKey;
+        std::string mongoUri;      // lets the write spool reopen the connection
+    };
+
+    struct Stats
+    {
+        std::string collectionKey;
+        size_t pending;     // merged updates waiting to be sent
+        uint64_t accepted;  // updates passed to Add
+        uint64_t sent;      // updateOne operations sent
+        uint64_t failed;    // operations the service did not apply
+        uint64_t requests;  // bulkWrite requests sent
+    };
+
+    explicit UpdateCoalescer(DocumentCache& cache);
+    ~UpdateCoalescer();
+
+    // Journal requests the API service could not take instead of dropping them
+    void SetSpool(WriteSpool* spool) { m_spool = spool; }
+
+    // Merge an update ({"$inc":{...},"$set":{...}}, compact JSON) into the
+    // pending update of the document matched by filterJson (compact JSON).
+    // Only $inc, $set, $max and $min are accepted; $inc values must be numbers.
+    // A field that cannot be merged (e.g. $set after $inc, or "a.b" after
+    // "a") or a different upsert flag starts a second update for the document
+    // so the order is kept.
+    bool Add(const Target& target, int flushIntervalMs, const std::string& filterJson,
+             const std::string& updateJson, bool upsert, std::string& error);
+
+    // Send the pending updates of one collection, or of all with an empty key, now
+    void Flush(const std::string& collectionKey);
+
+    // Send all pending updates, up to maxParallel collections at once, until
+    // the deadline. If the write spool is open, requests still running then
+    // are aborted and they and the remaining updates are journaled instead;
+    // otherwise they finish and the rest is sent by the background thread.
+    // Never waits past the deadline. Returns the number of updates still
+    // pending (not sent or spooled).
+    size_t Drain(std::chrono::steady_clock::time_point deadline, size_t maxParallel);
+
+    // Send what is left until the deadline, then abort the requests still
+    // running, journal the rest if the write spool is open and stop the
+    // thread (extension unload). Returns the number of updates dropped.
+    size_t Stop(std::chrono::steady_clock::time_point deadline);
+
+    bool GetStats(const std::string& collectionKey, Stats& stats) const;
+    Stats GetTotals() const;
+    std::vector<Stats> GetAllStats() const;
+
+    // Approximate heap bytes of the pending updates. Kept as a running total,
+    // so reading it does not walk the updates.
+    size_t GetMemoryUsage() const { return m_bytes; }
+
+    // Updates whose request broke off after it was sent: Drain or Stop aborted
+    // it, or it timed out. They may or may not have been applied, so they are
+    // counted as failed rather than spooled, which could write them twice.
+    uint64_t GetUnknownOutcomes() const { return m_unknown; }
+
+    std::string GetLastError() const;
+
+private:
+    enum Operator { Op_Inc, Op_Set, Op_Max, Op_Min, Op_Count };
+
+    struct Field
+    {
+        Operator op;
+        std::string value; // raw JSON
+    };
+
+    // One updateOne operation; fields are keyed by their quoted name
+    struct Update
+    {
+        std::map<std::string, Field> fields;
+        bool upsert;
+    };
+
+    struct Buffer
+    {
+        Buffer() : intervalMs(0), pending(0), bytes(0), flushNow(false), accepted(0), sent(0), failed(0), requests(0) {}
+
+        Target target;
+        int intervalMs;
+        std::map<std::string, std::vector<Update>> documents; // filter -> updates in order
+        size_t pending; // updates across all documents
+        size_t bytes;   // approximate heap bytes of documents, see UpdateBytes
+        std::chrono::steady_clock::time_point deadline; // first pending update + interval
+        bool flushNow;
+        uint64_t accepted;
+        uint64_t sent;
+        uint64_t failed;
+        uint64_t requests;
+    };
+
+    struct Batch
+    {
+        Target target;
+        std::vector<std::string> operations;
+        bool ordered;
+    };
+
+    static bool MergeField(Field& field, Operator op, const std::string& value);
+    static size_t UpdateBytes(const Update& update);
+    static std::string BuildOperation(const std::string& filterJson, const Update& update);
+
+    bool TakeDueLocked(std::chrono::steady_clock::time_point now, Batch& batch);
+    size_t PendingLocked() const;
+    void Spool(Batch& batch);
+    void Send(Batch& batch);
+    void SendDue(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline);
+    void SpoolDueLocked(std::unique_lock<std::mutex>& lock);
+    void JoinHelpersLocked(std::unique_lock<std::mutex>& lock);
+    void Run();
+
+    DocumentCache& m_cache;
+    std::atomic<WriteSpool*> m_spool;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Buffer> m_buffers; // collection key -> buffer
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;      // a batch finished sending
+    std::set<std::string> m_sending;     // collections with a batch being sent; one at a time keeps the order
+    size_t m_helpers;                    // Drain helper threads still running
+    std::vector<std::thread> m_helperThreads; // joined by the next Drain or Stop
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_cancel;          // aborts the requests in progress (Drain deadline)
+    std::atomic<uint64_t> m_unknown;     // see GetUnknownOutcomes
+    std::atomic<size_t> m_bytes;         // buffers and their pending updates, see GetMemoryUsage
+    std::thread m_thread;
+    std::string m_lastError;
+};
+
+#endif // _UPDATE_COALESCER_H_
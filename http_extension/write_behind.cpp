@@ -0,0 +1,438 @@
+/**
+ * MongoDB Extension Write-Behind Buffer Implementation
+ */
+
+#include "write_behind.h"
+#include "document_cache.h"
+#include "write_spool.h"
+#include "bulk_write.h"
+#include "http_transport.h"
+#include "json_utils.h"
+#include "request_trace.h"
+#include <cstdlib>
+#include <iterator>
+
+// Keeps a request well below the API service's 10 MB body limit
+static const size_t WRITE_BEHIND_MAX_BATCH_BYTES = 4 * 1024 * 1024;
+
+// Inserts are refused once this much is waiting for one collection
+static const size_t WRITE_BEHIND_MAX_PENDING_BYTES = 16 * 1024 * 1024;
+
+WriteBehindQueue::WriteBehindQueue(DocumentCache& cache)
+    : m_cache(cache)
+    , m_spool(nullptr)
+    , m_sending(0)
+    , m_helpers(0)
+    , m_stop(false)
+    , m_cancel(false)
+    , m_unknown(0)
+    , m_bytes(0)
+{
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+    Stop(std::chrono::steady_clock::now());
+}
+
+void WriteBehindQueue::Enable(const Target& target, size_t batchSize, int flushIntervalMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stop)
+        return;
+
+    auto found = m_buffers.find(target.collectionKey);
+    if (found == m_buffers.end())
+    {
+        found = m_buffers.emplace(target.collectionKey, Buffer()).first;
+        m_bytes += sizeof(Buffer) + found->first.capacity();
+    }
+    Buffer& buffer = found->second;
+    buffer.target = target;
+    buffer.batchSize = batchSize > 0 ? batchSize : 1;
+    buffer.intervalMs = flushIntervalMs > 0 ? flushIntervalMs : 1;
+    buffer.enabled = true;
+
+    if (!m_thread.joinable())
+        m_thread = std::thread(&WriteBehindQueue::Run, this);
+}
+
+void WriteBehindQueue::Disable(const std::string& collectionKey)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_buffers.find(collectionKey);
+        if (it == m_buffers.end())
+            return;
+
+        it->second.enabled = false;
+        it->second.flushNow = !it->second.documents.empty();
+    }
+    m_wake.notify_one();
+}
+
+bool WriteBehindQueue::IsEnabled(const std::string& collectionKey) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_buffers.find(collectionKey);
+    return it != m_buffers.end() && it->second.enabled;
+}
+
+bool WriteBehindQueue::Add(const std::string& collectionKey, const std::string& documentJson)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_buffers.find(collectionKey);
+        if (m_stop || it == m_buffers.end() || !it->second.enabled)
+            return false;
+
+        Buffer& buffer = it->second;
+        if (buffer.bytes + documentJson.size() > WRITE_BEHIND_MAX_PENDING_BYTES)
+            return false;
+
+        if (buffer.documents.empty())
+            buffer.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(buffer.intervalMs);
+
+        buffer.documents.push_back(documentJson);
+        buffer.bytes += documentJson.size();
+        m_bytes += sizeof(std::string) + documentJson.size();
+        buffer.queued++;
+
+        // The thread sleeps until the earliest deadline; only a full batch
+        // or a new deadline needs to wake it early
+        wake = buffer.documents.size() == 1 || buffer.documents.size() >= buffer.batchSize ||
+               buffer.bytes >= WRITE_BEHIND_MAX_BATCH_BYTES;
+    }
+
+    if (wake)
+        m_wake.notify_one();
+    return true;
+}
+
+void WriteBehindQueue::Flush(const std::string& collectionKey)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_buffers)
+        {
+            if ((collectionKey.empty() || entry.first == collectionKey) && !entry.second.documents.empty())
+                entry.second.flushNow = true;
+        }
+    }
+    m_wake.notify_one();
+}
+
+// Join the Drain helpers; only called once none is running
+void WriteBehindQueue::JoinHelpersLocked(std::unique_lock<std::mutex>& lock)
+{
+    std::vector<std::thread> helpers;
+    helpers.swap(m_helperThreads);
+    lock.unlock();
+    for (std::thread& helper : helpers)
+        helper.join();
+    lock.lock();
+}
+
+size_t WriteBehindQueue::Drain(std::chrono::steady_clock::time_point deadline, size_t maxParallel)
+{
+    Flush("");
+
+    // Helpers send batches next to the background thread until nothing is due
+    // or the deadline passes. Without the spool a request they started runs to
+    // its end after Drain returns; Stop joins them then.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_helpers == 0)
+        JoinHelpersLocked(lock); // left over from the last Drain
+    for (size_t i = 1; i < maxParallel; i++)
+    {
+        m_helpers++;
+        m_helperThreads.emplace_back([this, deadline]() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            SendDue(lock, deadline);
+            m_helpers--;
+            m_idle.notify_all();
+        });
+    }
+
+    m_idle.wait_until(lock, deadline, [this]() { return m_sending == 0 && PendingLocked() == 0; });
+
+    // Out of time: journal the rest instead of waiting for it
+    WriteSpool* spool = m_spool;
+    if ((m_sending > 0 || PendingLocked() > 0) && spool && spool->IsOpen())
+    {
+        m_cancel = true;
+        m_idle.wait(lock, [this]() { return m_sending == 0; });
+        SpoolDueLocked(lock, spool);
+        m_cancel = false;
+        m_wake.notify_one();
+    }
+
+    if (m_helpers == 0)
+        JoinHelpersLocked(lock);
+    return PendingLocked();
+}
+
+size_t WriteBehindQueue::Stop(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_wake.notify_all();
+    m_idle.wait_until(lock, deadline, [this]() {
+        return m_sending == 0 && m_helpers == 0 && PendingLocked() == 0;
+    });
+
+    // Out of time: abort what is running; the thread takes no more batches
+    m_cancel = true;
+    m_idle.wait(lock, [this]() { return m_sending == 0 && m_helpers == 0; });
+    JoinHelpersLocked(lock);
+    if (m_thread.joinable())
+    {
+        lock.unlock();
+        m_wake.notify_all();
+        m_thread.join();
+        lock.lock();
+    }
+
+    WriteSpool* spool = m_spool;
+    if (spool && spool->IsOpen())
+        SpoolDueLocked(lock, spool);
+
+    size_t dropped = 0;
+    for (auto& entry : m_buffers)
+    {
+        Buffer& buffer = entry.second;
+        dropped += buffer.documents.size();
+        buffer.failed += buffer.documents.size();
+        m_bytes -= buffer.documents.size() * sizeof(std::string) + buffer.bytes;
+        buffer.documents.clear();
+        buffer.bytes = 0;
+    }
+    if (dropped > 0)
+        m_lastError = "unloading, dropped " + std::to_string(dropped) + " buffered documents";
+    return dropped;
+}
+
+static WriteBehindQueue::Stats MakeStats(const std::string& key, size_t pending, uint64_t queued,
+                                         uint64_t written, uint64_t failed, uint64_t requests)
+{
+    WriteBehindQueue::Stats stats = { key, pending, queued, written, failed, requests };
+    return stats;
+}
+
+bool WriteBehindQueue::GetStats(const std::string& collectionKey, Stats& stats) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_buffers.find(collectionKey);
+    if (it == m_buffers.end())
+        return false;
+
+    const Buffer& buffer = it->second;
+    stats = MakeStats(it->first, buffer.documents.size(), buffer.queued, buffer.written,
+                      buffer.failed, buffer.requests);
+    return true;
+}
+
+WriteBehindQueue::Stats WriteBehindQueue::GetTotals() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats totals = MakeStats("", 0, 0, 0, 0, 0);
+    for (const auto& entry : m_buffers)
+    {
+        totals.pending += entry.second.documents.size();
+        totals.queued += entry.second.queued;
+        totals.written += entry.second.written;
+        totals.failed += entry.second.failed;
+        totals.requests += entry.second.requests;
+    }
+    return totals;
+}
+
+std::vector<WriteBehindQueue::Stats> WriteBehindQueue::GetAllStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Stats> result;
+    for (const auto& entry : m_buffers)
+    {
+        const Buffer& buffer = entry.second;
+        result.push_back(MakeStats(entry.first, buffer.documents.size(), buffer.queued, buffer.written,
+                                   buffer.failed, buffer.requests));
+    }
+    return result;
+}
+
+std::string WriteBehindQueue::GetLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+size_t WriteBehindQueue::PendingLocked() const
+{
+    size_t pending = 0;
+    for (const auto& entry : m_buffers)
+        pending += entry.second.documents.size();
+    return pending;
+}
+
+bool WriteBehindQueue::TakeDueLocked(std::chrono::steady_clock::time_point now, Batch& batch)
+{
+    for (auto& entry : m_buffers)
+    {
+        Buffer& buffer = entry.second;
+        if (buffer.documents.empty())
+            continue;
+
+        bool due = m_stop || buffer.flushNow || now >= buffer.deadline ||
+                   buffer.documents.size() >= buffer.batchSize || buffer.bytes >= WRITE_BEHIND_MAX_BATCH_BYTES;
+        if (!due)
+            continue;
+
+        // Take at most one batch; the rest waits for the next pass
+        size_t count = 0, bytes = 0;
+        while (count < buffer.documents.size() && count < buffer.batchSize &&
+               (count == 0 || bytes + buffer.documents[count].size() <= WRITE_BEHIND_MAX_BATCH_BYTES))
+        {
+            bytes += buffer.documents[count].size();
+            count++;
+        }
+
+        batch.target = buffer.target;
+        batch.documents.assign(std::make_move_iterator(buffer.documents.begin()),
+                               std::make_move_iterator(buffer.documents.begin() + count));
+        buffer.documents.erase(buffer.documents.begin(), buffer.documents.begin() + count);
+        buffer.bytes -= bytes;
+        m_bytes -= count * sizeof(std::string) + bytes;
+        buffer.requests++;
+
+        if (buffer.documents.empty())
+            buffer.flushNow = false;
+        else if (!buffer.flushNow)
+            buffer.deadline = now + std::chrono::milliseconds(buffer.intervalMs);
+        return true;
+    }
+    return false;
+}
+
+void WriteBehindQueue::Send(Batch& batch)
+{
+    RequestTraceScope trace("write-behind");
+
+    // Unordered, so one rejected document does not hold back the rest
+    std::string postData = InsertManyBody(batch.documents, { 0, batch.documents.size() }, false);
+
+    // While the spool drains, new writes queue up behind the journaled ones
+    WriteSpool* spool = m_spool;
+    if (spool && spool->IsDeferring() && spool->Append(batch.target.insertManyUrl, batch.target.mongoUri, postData))
+        return;
+
+    std::string response, data, insertedCount, successValue;
+    long statusCode;
+    bool transferred = HttpServicePost(batch.target.insertManyUrl, postData, batch.target.apiKey, response, statusCode,
+                                       &m_cancel);
+    bool success = transferred && statusCode < 400 && JsonGetMember(response, "success", successValue) &&
+                   successValue == "true" && JsonGetMember(response, "data", data);
+
+    // Keep the batch for later if the service or database is down; never one
+    // that was aborted after sending (see GetUnknownOutcomes)
+    bool aborted = statusCode == HTTP_STATUS_ABORTED;
+    bool spooled = !success && spool && HttpServiceUnavailable(transferred, statusCode, response) &&
+                   spool->Append(batch.target.insertManyUrl, batch.target.mongoUri, postData);
+
+    uint64_t written = 0;
+    if (success && JsonGetMember(data, "insertedCount", insertedCount))
+        written = strtoull(insertedCount.c_str(), nullptr, 10);
+    else if (success)
+        written = batch.documents.size();
+
+    if (written > 0 || aborted)
+        m_cache.InvalidateCollection(batch.target.collectionKey);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Buffer& buffer = m_buffers[batch.target.collectionKey];
+    buffer.written += written;
+    if (!success && !spooled)
+    {
+        buffer.failed += batch.documents.size();
+        if (aborted)
+            m_unknown += batch.documents.size();
+        m_lastError = "insertMany of " + std::to_string(batch.documents.size()) + " documents " +
+                      (aborted ? "aborted, outcome unknown: " : "failed: ") +
+                      batch.target.insertManyUrl.substr(batch.target.insertManyUrl.find("/databases/") + 11);
+    }
+}
+
+// Send batches until none is due, the deadline passes or Drain/Stop cancels;
+// called with the lock held
+void WriteBehindQueue::SendDue(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline)
+{
+    Batch batch;
+    auto now = std::chrono::steady_clock::now();
+    while (!m_cancel && now < deadline && TakeDueLocked(now, batch))
+    {
+        m_sending++;
+        lock.unlock();
+        Send(batch);
+        lock.lock();
+        m_sending--;
+        m_idle.notify_all();
+        now = std::chrono::steady_clock::now();
+    }
+}
+
+// Journal every buffered document without sending it; called with the lock held
+void WriteBehindQueue::SpoolDueLocked(std::unique_lock<std::mutex>& lock, WriteSpool* spool)
+{
+    Batch batch;
+    while (TakeDueLocked(std::chrono::steady_clock::now(), batch))
+    {
+        lock.unlock();
+        std::string postData = InsertManyBody(batch.documents, { 0, batch.documents.size() }, false);
+        bool spooled = spool->Append(batch.target.insertManyUrl, batch.target.mongoUri, postData);
+        lock.lock();
+
+        if (!spooled)
+        {
+            m_buffers[batch.target.collectionKey].failed += batch.documents.size();
+            m_lastError = "write spool is full, dropped " + std::to_string(batch.documents.size()) +
+                          " buffered documents";
+        }
+    }
+}
+
+void WriteBehindQueue::Run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        SendDue(lock, std::chrono::steady_clock::time_point::max());
+        auto now = std::chrono::steady_clock::now();
+
+        if (m_stop)
+            return;
+
+        // Drain is journaling the buffers; wait until it is done
+        if (m_cancel)
+        {
+            m_wake.wait(lock, [this]() { return !m_cancel || m_stop; });
+            continue;
+        }
+
+        // Sleep until the earliest deadline, or until Add/Flush wakes us
+        bool pending = false;
+        auto wakeAt = now + std::chrono::hours(1);
+        for (const auto& entry : m_buffers)
+        {
+            if (!entry.second.documents.empty() && entry.second.deadline < wakeAt)
+            {
+                wakeAt = entry.second.deadline;
+                pending = true;
+            }
+        }
+
+        if (pending)
+            m_wake.wait_until(lock, wakeAt);
+        else
+            m_wake.wait(lock);
+    }
+}
@@ -0,0 +1,146 @@
+/**
+ * MongoDB Extension Write-Behind Buffer
+ * Collects single-document inserts of opted-in collections and sends them
+ * as one insertMany request per batch from a background thread
+ */
+
+#ifndef _WRITE_BEHIND_H_
+#define _WRITE_BEHIND_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class DocumentCache;
+class WriteSpool;
+
+class WriteBehindQueue
+{
+public:
+    // Where a collection's batches go; built on the game thread
+    struct Target
+    {
+        std::string collectionKey; // document cache key of the collection
+        std::string insertManyUrl;
+        std::string apiKey;
+        std::string mongoUri;      // lets the write spool reopen the connection
+    };
+
+    struct Stats
+    {
+        std::string collectionKey;
+        size_t pending;     // documents waiting in the buffer
+        uint64_t queued;    // documents accepted
+        uint64_t written;   // documents the service confirmed
+        uint64_t failed;    // documents of batches that failed
+        uint64_t requests;  // insertMany requests sent
+    };
+
+    explicit WriteBehindQueue(DocumentCache& cache);
+    ~WriteBehindQueue();
+
+    // Journal requests the API service could not take instead of dropping them
+    void SetSpool(WriteSpool* spool) { m_spool = spool; }
+
+    // Buffer inserts of a collection; a batch is sent once batchSize documents
+    // are queued or flushIntervalMs after its first document, whichever is first
+    void Enable(const Target& target, size_t batchSize, int flushIntervalMs);
+
+    // Stop buffering; documents already queued are still sent
+    void Disable(const std::string& collectionKey);
+    bool IsEnabled(const std::string& collectionKey) const;
+
+    // Queue a document (compact JSON object). Returns false if the collection
+    // is not buffered or its buffer is full.
+    bool Add(const std::string& collectionKey, const std::string& documentJson);
+
+    // Send the buffer of one collection, or of all with an empty key, now
+    void Flush(const std::string& collectionKey);
+
+    // Send everything buffered, up to maxParallel batches at once, until the
+    // deadline. If the write spool is open, requests still running then are
+    // aborted and they and the rest of the buffers are journaled instead;
+    // otherwise they finish and the rest is sent by the background thread.
+    // Never waits past the deadline. Returns the number of documents still
+    // pending (not sent or spooled).
+    size_t Drain(std::chrono::steady_clock::time_point deadline, size_t maxParallel);
+
+    // Send what is left until the deadline, then abort the requests still
+    // running, journal the rest if the write spool is open and stop the
+    // thread (extension unload). Returns the number of documents dropped.
+    size_t Stop(std::chrono::steady_clock::time_point deadline);
+
+    bool GetStats(const std::string& collectionKey, Stats& stats) const;
+    Stats GetTotals() const;
+    std::vector<Stats> GetAllStats() const;
+
+    // Approximate heap bytes of the buffered documents. Kept as a running
+    // total, so reading it does not walk the buffers.
+    size_t GetMemoryUsage() const { return m_bytes; }
+
+    // Documents whose request broke off after it was sent: Drain or Stop aborted
+    // it, or it timed out. They may or may not have been applied, so they are
+    // counted as failed rather than spooled, which could write them twice.
+    uint64_t GetUnknownOutcomes() const { return m_unknown; }
+
+    std::string GetLastError() const;
+
+private:
+    struct Buffer
+    {
+        Buffer() : batchSize(0), intervalMs(0), bytes(0), enabled(false), flushNow(false),
+                   queued(0), written(0), failed(0), requests(0) {}
+
+        Target target;
+        size_t batchSize;
+        int intervalMs;
+        std::vector<std::string> documents;
+        size_t bytes;
+        std::chrono::steady_clock::time_point deadline; // first queued document + interval
+        bool enabled;
+        bool flushNow;
+        uint64_t queued;
+        uint64_t written;
+        uint64_t failed;
+        uint64_t requests;
+    };
+
+    struct Batch
+    {
+        Target target;
+        std::vector<std::string> documents;
+    };
+
+    bool TakeDueLocked(std::chrono::steady_clock::time_point now, Batch& batch);
+    size_t PendingLocked() const;
+    void Send(Batch& batch);
+    void SendDue(std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point deadline);
+    void SpoolDueLocked(std::unique_lock<std::mutex>& lock, WriteSpool* spool);
+    void JoinHelpersLocked(std::unique_lock<std::mutex>& lock);
+    void Run();
+
+    DocumentCache& m_cache;
+    std::atomic<WriteSpool*> m_spool;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Buffer> m_buffers; // collection key -> buffer
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;  // a batch finished sending
+    size_t m_sending;                // batches being sent
+    size_t m_helpers;                // Drain helper threads still running
+    std::vector<std::thread> m_helperThreads; // joined by the next Drain or Stop
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_cancel;      // aborts the requests in progress (Drain deadline)
+    std::atomic<uint64_t> m_unknown; // see GetUnknownOutcomes
+    std::atomic<size_t> m_bytes;     // buffers and their documents, see GetMemoryUsage
+    std::thread m_thread;
+    std::string m_lastError;
+};
+
+#endif // _WRITE_BEHIND_H_
@@ -0,0 +1,496 @@
+/**
+ * MongoDB Extension Write Spool Implementation
+ *
+ * Spool file layout (host byte order), one entry per journaled write:
+ *   RecordHeader, then five strings (uint32 length + bytes each):
+ *   base URL, MongoDB URI, connection id, path after the connection id, body
+ *
+ * The highest sequence number the service has applied is kept in a separate
+ * file, so records are never replayed twice unless the server stops between
+ * a replay and the update of that file. Once everything is replayed the
+ * spool file is truncated; sequence numbers keep counting up.
+ */
+
+#include "write_spool.h"
+#include "document_cache.h"
+#include "http_transport.h"
+#include "json_utils.h"
+#include "file_utils.h"
+#include "request_trace.h"
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char SPOOL_MAGIC[4] = { 'M', 'G', 'W', 'S' };
+
+// Longest wait between two reachability probes while the service is down
+static const int SPOOL_MAX_BACKOFF_SECONDS = 30;
+
+struct RecordHeader
+{
+    char magic[4];
+    uint32_t length;    // bytes after the header
+    uint64_t sequence;
+    uint64_t checksum;  // FNV-1a of the sequence number and the payload
+};
+
+static uint64_t Checksum(uint64_t sequence, const std::string& payload)
+{
+    return Fnv1a(payload.data(), payload.length(), Fnv1a(&sequence, sizeof(sequence)));
+}
+
+static void AppendString(std::string& payload, const std::string& value)
+{
+    uint32_t length = static_cast<uint32_t>(value.length());
+    payload.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    payload += value;
+}
+
+static bool ReadString(const std::string& payload, size_t& pos, std::string& value)
+{
+    uint32_t length;
+    if (pos + sizeof(length) > payload.length())
+        return false;
+    memcpy(&length, payload.data() + pos, sizeof(length));
+    pos += sizeof(length);
+    if (pos + length > payload.length())
+        return false;
+    value.assign(payload, pos, length);
+    pos += length;
+    return true;
+}
+
+static void TruncateFile(const std::string& path, uint64_t size)
+{
+#ifdef WIN32
+    FILE* file = fopen(path.c_str(), "r+b");
+    if (file)
+    {
+        _chsize_s(_fileno(file), static_cast<__int64>(size));
+        fclose(file);
+    }
+#else
+    if (truncate(path.c_str(), static_cast<off_t>(size)) != 0)
+        return;
+#endif
+}
+
+WriteSpool::WriteSpool(DocumentCache& cache)
+    : m_cache(cache)
+    , m_maxBytes(0)
+    , m_file(nullptr)
+    , m_fileSize(0)
+    , m_replayOffset(0)
+    , m_pending(0)
+    , m_nextSequence(1)
+    , m_appliedSequence(0)
+    , m_spooled(0)
+    , m_replayed(0)
+    , m_rejected(0)
+    , m_unknown(0)
+    , m_replaying(false)
+    , m_stop(false)
+{
+}
+
+WriteSpool::~WriteSpool()
+{
+    Stop();
+}
+
+bool WriteSpool::ReadRecord(FILE* file, Record& record, uint64_t& size)
+{
+    RecordHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC)) != 0)
+        return false;
+
+    std::string payload(header.length, '\0');
+    if (header.length > 0 && fread(&payload[0], header.length, 1, file) != 1)
+        return false;
+    if (Checksum(header.sequence, payload) != header.checksum)
+        return false;
+
+    size_t pos = 0;
+    record.sequence = header.sequence;
+    size = sizeof(header) + header.length;
+    return ReadString(payload, pos, record.baseUrl) && ReadString(payload, pos, record.mongoUri) &&
+           ReadString(payload, pos, record.connectionId) && ReadString(payload, pos, record.path) &&
+           ReadString(payload, pos, record.body);
+}
+
+bool WriteSpool::Open(const std::string& directory, size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file)
+        return true;
+
+    CreateDirectories(directory); // a failure shows when the spool file is opened
+    m_spoolPath = directory + "/writes.spool";
+    m_appliedPath = directory + "/writes.applied";
+    m_maxBytes = maxBytes;
+
+    FILE* applied = fopen(m_appliedPath.c_str(), "rb");
+    if (applied)
+    {
+        char buffer[32] = {};
+        if (fread(buffer, 1, sizeof(buffer) - 1, applied) > 0)
+            m_appliedSequence = strtoull(buffer, nullptr, 10);
+        fclose(applied);
+    }
+    m_nextSequence = m_appliedSequence + 1;
+
+    // Find the first record not applied yet; drop a torn record at the end
+    uint64_t offset = 0;
+    m_replayOffset = UINT64_MAX;
+    m_pending = 0;
+    FILE* existing = fopen(m_spoolPath.c_str(), "rb");
+    if (existing)
+    {
+        Record record;
+        uint64_t size;
+        while (ReadRecord(existing, record, size))
+        {
+            if (record.sequence > m_appliedSequence)
+            {
+                if (m_replayOffset == UINT64_MAX)
+                    m_replayOffset = offset;
+                m_pending++;
+            }
+            if (record.sequence >= m_nextSequence)
+                m_nextSequence = record.sequence + 1;
+            offset += size;
+        }
+
+        fseek(existing, 0, SEEK_END);
+        bool torn = static_cast<uint64_t>(ftell(existing)) != offset;
+        fclose(existing);
+        if (torn)
+        {
+            m_lastError = "Spool file damaged after " + std::to_string(offset) + " bytes; later records dropped";
+            TruncateFile(m_spoolPath, offset);
+        }
+    }
+
+    m_fileSize = offset;
+    if (m_replayOffset == UINT64_MAX)
+        m_replayOffset = m_fileSize;
+
+    m_file = fopen(m_spoolPath.c_str(), "ab");
+    if (!m_file)
+    {
+        m_lastError = "Cannot open " + m_spoolPath;
+        return false;
+    }
+
+    if (m_pending > 0 && !m_thread.joinable())
+        m_thread = std::thread(&WriteSpool::Run, this);
+    return true;
+}
+
+bool WriteSpool::IsOpen() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file != nullptr;
+}
+
+void WriteSpool::SetApiKey(const std::string& apiKey)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_apiKey = apiKey;
+}
+
+bool WriteSpool::IsDeferring() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending > 0;
+}
+
+bool WriteSpool::Append(const std::string& url, const std::string& mongoUri, const std::string& body)
+{
+    // Split ".../api/v1/connections/<id>/rest" so replay can swap the id
+    static const std::string marker = "/api/v1/connections/";
+    size_t idStart = url.find(marker);
+    size_t idEnd = idStart == std::string::npos ? std::string::npos : url.find('/', idStart + marker.length());
+    if (idEnd == std::string::npos)
+        return false;
+
+    std::string payload;
+    AppendString(payload, url.substr(0, idStart));
+    AppendString(payload, mongoUri);
+    AppendString(payload, url.substr(idStart + marker.length(), idEnd - idStart - marker.length()));
+    AppendString(payload, url.substr(idEnd));
+    AppendString(payload, body);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file || m_stop)
+            return false;
+
+        uint64_t size = sizeof(RecordHeader) + payload.length();
+        if (m_fileSize + size > m_maxBytes)
+        {
+            m_lastError = "Spool full (" + std::to_string(m_fileSize / 1024) + " KB)";
+            return false;
+        }
+
+        RecordHeader header;
+        memcpy(header.magic, SPOOL_MAGIC, sizeof(SPOOL_MAGIC));
+        header.length = static_cast<uint32_t>(payload.length());
+        header.sequence = m_nextSequence;
+        header.checksum = Checksum(header.sequence, payload);
+
+        if (fwrite(&header, sizeof(header), 1, m_file) != 1 ||
+            fwrite(payload.data(), payload.length(), 1, m_file) != 1 || fflush(m_file) != 0)
+        {
+            // A partial record is dropped as torn on the next load
+            m_lastError = "Cannot write to " + m_spoolPath;
+            return false;
+        }
+
+        if (m_pending == 0)
+            m_replayOffset = m_fileSize;
+        m_fileSize += size;
+        m_nextSequence++;
+        m_pending++;
+        m_spooled++;
+
+        if (!m_thread.joinable())
+            m_thread = std::thread(&WriteSpool::Run, this);
+    }
+
+    m_wake.notify_one();
+    return true;
+}
+
+void WriteSpool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+WriteSpool::Stats WriteSpool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.pendingRecords = m_pending;
+    stats.pendingBytes = m_fileSize - m_replayOffset;
+    stats.spooled = m_spooled;
+    stats.replayed = m_replayed;
+    stats.rejected = m_rejected;
+    stats.unknown = m_unknown;
+    stats.lastSequence = m_nextSequence - 1;
+    stats.appliedSequence = m_appliedSequence;
+    stats.replaying = m_replaying;
+    return stats;
+}
+
+std::string WriteSpool::GetLastError() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+bool WriteSpool::WriteAppliedSequence(uint64_t sequence)
+{
+    // Write a temporary file and rename it so a crash never leaves a partial number
+    std::string tempPath = m_appliedPath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (!file)
+        return false;
+
+    std::string text = std::to_string(sequence);
+    bool written = fwrite(text.data(), text.length(), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+#ifdef WIN32
+    remove(m_appliedPath.c_str());
+#endif
+    return written && rename(tempPath.c_str(), m_appliedPath.c_str()) == 0;
+}
+
+WriteSpool::ReplayResult WriteSpool::Replay(Record& record)
+{
+    RequestTraceScope trace("spool replay");
+    std::string apiKey;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        apiKey = m_apiKey;
+    }
+
+    // Only this thread uses m_connections
+    std::string connectionKey = record.baseUrl + "|" + record.mongoUri;
+    auto known = m_connections.find(connectionKey);
+    std::string connectionId = known != m_connections.end() ? known->second : record.connectionId;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        std::string url = record.baseUrl + "/api/v1/connections/" + connectionId + record.path;
+        std::string response;
+        long statusCode;
+        if (!HttpServicePost(url, record.body, apiKey, response, statusCode, &m_stop))
+        {
+            // Sending it again could apply it twice
+            return statusCode == HTTP_STATUS_ABORTED ? Replay_Unknown : Replay_Unreachable;
+        }
+
+        bool unknownConnection = statusCode == 404 && response.find("CONNECTION_NOT_FOUND") != std::string::npos;
+        if (unknownConnection && attempt == 0)
+        {
+            // The service was restarted and forgot the connection; open a new one
+            std::string uri;
+            for (char c : record.mongoUri)
+            {
+                if (c == '"' || c == '\\')
+                    uri += '\\';
+                uri += c;
+            }
+
+            std::string data, id;
+            if (!HttpServicePostData(record.baseUrl + "/api/v1/connections", "{\"uri\":\"" + uri + "\"}", apiKey,
+                                     data, &m_stop) ||
+                !JsonGetMember(data, "connectionId", id))
+                return Replay_Unreachable;
+
+            connectionId = JsonUnquote(id);
+            m_connections[connectionKey] = connectionId;
+            continue;
+        }
+
+        // Service or database down; anything else is an answer about this write
+        if (HttpServiceUnavailable(true, statusCode, response))
+            return Replay_Unreachable;
+
+        std::string success;
+        return JsonGetMember(response, "success", success) && success == "true" ? Replay_Applied : Replay_Rejected;
+    }
+    return Replay_Unreachable;
+}
+
+// Document cache key of the collection a record writes to, built like the
+// extension's collection keys: base URL, MongoDB URI and "db/collection".
+// Empty if the path names no collection.
+std::string WriteSpool::CollectionKeyOf(const Record& record)
+{
+    static const std::string databases = "/databases/";
+    static const std::string collections = "/collections/";
+    if (record.path.compare(0, databases.length(), databases) != 0)
+        return "";
+
+    size_t dbEnd = record.path.find('/', databases.length());
+    if (dbEnd == std::string::npos || record.path.compare(dbEnd, collections.length(), collections) != 0)
+        return "";
+
+    size_t nameStart = dbEnd + collections.length();
+    size_t nameEnd = record.path.find('/', nameStart);
+    std::string database = record.path.substr(databases.length(), dbEnd - databases.length());
+    std::string name = record.path.substr(nameStart, nameEnd == std::string::npos ? std::string::npos : nameEnd - nameStart);
+    return record.baseUrl + "|" + record.mongoUri + "|" + HttpDecodePathSegment(database) + "/" +
+           HttpDecodePathSegment(name);
+}
+
+void WriteSpool::Run()
+{
+    int backoffSeconds = 1;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop)
+    {
+        if (m_pending == 0)
+        {
+            // Everything is applied; start the file over
+            if (m_fileSize > 0 && m_file)
+            {
+                fclose(m_file);
+                m_file = fopen(m_spoolPath.c_str(), "wb");
+                if (m_file)
+                {
+                    fclose(m_file);
+                    m_file = fopen(m_spoolPath.c_str(), "ab");
+                }
+                m_fileSize = 0;
+                m_replayOffset = 0;
+            }
+            m_replaying = false;
+            m_wake.wait(lock, [this] { return m_stop || m_pending > 0; });
+            continue;
+        }
+
+        // Read the oldest record; appends hold the same lock
+        Record record;
+        uint64_t size = 0;
+        bool valid = false;
+        FILE* file = fopen(m_spoolPath.c_str(), "rb");
+        if (file)
+        {
+            valid = fseek(file, static_cast<long>(m_replayOffset), SEEK_SET) == 0 && ReadRecord(file, record, size);
+            fclose(file);
+        }
+
+        if (!valid)
+        {
+            m_lastError = "Cannot read spool record at offset " + std::to_string(m_replayOffset) +
+                          "; " + std::to_string(m_pending) + " records dropped";
+            m_pending = 0;
+            m_replayOffset = m_fileSize;
+            continue;
+        }
+
+        lock.unlock();
+        ReplayResult result = Replay(record);
+        if (result != Replay_Unreachable)
+        {
+            WriteAppliedSequence(record.sequence);
+            // Reads cached while the write waited here predate it; a refused
+            // ordered batch may still have applied its first operations
+            std::string collectionKey = CollectionKeyOf(record);
+            if (!collectionKey.empty())
+                m_cache.InvalidateCollection(collectionKey);
+        }
+        lock.lock();
+
+        if (result == Replay_Unreachable)
+        {
+            m_replaying = false;
+            m_wake.wait_for(lock, std::chrono::seconds(backoffSeconds), [this] { return m_stop.load(); });
+            backoffSeconds = backoffSeconds * 2 > SPOOL_MAX_BACKOFF_SECONDS ? SPOOL_MAX_BACKOFF_SECONDS : backoffSeconds * 2;
+            continue;
+        }
+
+        backoffSeconds = 1;
+        m_replaying = true;
+        m_replayOffset += size;
+        m_pending--;
+        m_appliedSequence = record.sequence;
+        if (result == Replay_Applied)
+        {
+            m_replayed++;
+        }
+        else if (result == Replay_Unknown)
+        {
+            m_unknown++;
+            m_lastError = "Replay of spooled write #" + std::to_string(record.sequence) + " to " + record.path +
+                          " broke off after it was sent; it may have been applied and is not retried";
+        }
+        else
+        {
+            m_rejected++;
+            m_lastError = "Service refused spooled write #" + std::to_string(record.sequence) + " to " + record.path;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * MongoDB Extension Write Spool
+ * Append-only journal of writes the API service could not take. A background
+ * thread replays them in order once the service answers again.
+ */
+
+#ifndef _WRITE_SPOOL_H_
+#define _WRITE_SPOOL_H_
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+class DocumentCache;
+
+class WriteSpool
+{
+public:
+    struct Stats
+    {
+        size_t pendingRecords;     // writes waiting for replay
+        uint64_t pendingBytes;     // spool file bytes not replayed yet
+        uint64_t spooled;          // writes journaled since load
+        uint64_t replayed;         // writes the service applied on replay
+        uint64_t rejected;         // writes the service refused on replay (dropped)
+        uint64_t unknown;          // replays that broke off after sending (dropped, may be applied)
+        uint64_t lastSequence;     // sequence number of the newest record
+        uint64_t appliedSequence;  // highest sequence number known to be applied
+        bool replaying;            // the service is reachable and the spool is draining
+    };
+
+    // Replayed writes drop the cached reads of their collection
+    explicit WriteSpool(DocumentCache& cache);
+    ~WriteSpool();
+
+    // Open (or create) the spool in a directory and queue records left over
+    // from an earlier run. maxBytes bounds the spool file.
+    bool Open(const std::string& directory, size_t maxBytes);
+    bool IsOpen() const;
+
+    // Key sent with replayed requests; it is never written to disk
+    void SetApiKey(const std::string& apiKey);
+
+    // True while records are waiting. New writes must then go to the spool
+    // as well, or they would overtake the journaled ones.
+    bool IsDeferring() const;
+
+    // Journal a POST to url (.../api/v1/connections/<id>/...). mongoUri is used
+    // to open a new connection if the service forgot the old id.
+    // Thread-safe; returns false if the spool is closed or full.
+    bool Append(const std::string& url, const std::string& mongoUri, const std::string& body);
+
+    // Stop the replay thread (extension unload); records stay on disk
+    void Stop();
+
+    Stats GetStats() const;
+    std::string GetLastError() const;
+
+private:
+    struct Record
+    {
+        uint64_t sequence;
+        std::string baseUrl;
+        std::string mongoUri;
+        std::string path; // after the connection id
+        std::string connectionId;
+        std::string body;
+    };
+
+    enum ReplayResult { Replay_Applied, Replay_Rejected, Replay_Unknown, Replay_Unreachable };
+
+    bool ReadRecord(FILE* file, Record& record, uint64_t& size);
+    bool WriteAppliedSequence(uint64_t sequence);
+    ReplayResult Replay(Record& record);
+    static std::string CollectionKeyOf(const Record& record);
+    void Run();
+
+    DocumentCache& m_cache;
+    std::string m_spoolPath;
+    std::string m_appliedPath;
+    size_t m_maxBytes;
+
+    mutable std::mutex m_mutex;
+    FILE* m_file;              // append handle
+    uint64_t m_fileSize;
+    uint64_t m_replayOffset;   // first byte not replayed yet
+    size_t m_pending;
+    uint64_t m_nextSequence;
+    uint64_t m_appliedSequence;
+    uint64_t m_spooled;
+    uint64_t m_replayed;
+    uint64_t m_rejected;
+    uint64_t m_unknown;
+    bool m_replaying;
+    std::string m_apiKey;
+    std::string m_lastError;
+    std::map<std::string, std::string> m_connections; // base URL + MongoDB URI -> connection id for replay
+
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+};
+
+#endif // _WRITE_SPOOL_H_
@@ -12,6 +12,10 @@ export interface AppError extends Error {
   isOperational?: boolean;
 }
 
+// MongoDB network errors; the request may succeed if sent again later
+export const isDatabaseUnavailable = (error: Error): boolean =>
+  /server selection timed out|ECONNREFUSED|ECONNRESET|ETIMEDOUT|topology is closed|connection .* closed/i.test(error.message);
+
 export const errorHandler = (
   error: AppError,
   req: Request,
@@ -49,6 +53,11 @@ export const errorHandler = (
     statusCode = 503;
     code = 'CONNECTION_ERROR';
     message = 'Database connection failed';
+  } else if (isDatabaseUnavailable(error)) {
+    // MongoDB is unreachable; clients may retry the same request later
+    statusCode = 503;
+    code = 'DATABASE_UNAVAILABLE';
+    message = 'Database unavailable';
   }
 
   // Don't expose internal errors in production
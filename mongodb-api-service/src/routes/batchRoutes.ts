@@ -1,13 +1,200 @@
 /**
  * Batch operation routes
- * TODO: Implement batch processing
+ * Runs operations on any number of collections in one request
  */
 
-import { Router } from 'express';
+import { Router, Request, Response } from 'express';
+import { body, validationResult } from 'express-validator';
+import { ConnectionManager } from '../managers/ConnectionManager';
+import { ApiResponse, BatchOperation, BatchOperationResult, BatchRequest, BatchResult, MongoDocument } from '../types';
+import { asyncHandler, isDatabaseUnavailable } from '../middleware/errorHandler';
+import { logger } from '../utils/logger';
 
 const router = Router();
 
-// Placeholder - will implement batch operations
-// POST /api/v1/batch
+// Upper bound on the operations of one batch
+const MAX_BATCH_OPERATIONS = 1000;
+
+const OPERATION_TYPES = [
+  'insertOne', 'insertMany', 'updateOne', 'updateMany', 'deleteOne', 'deleteMany', 'find', 'findOne', 'count',
+];
+
+// Validation middleware
+const validateBatch = [
+  body('operations')
+    .isArray({ min: 1, max: MAX_BATCH_OPERATIONS })
+    .withMessage(`operations must be an array of 1 to ${MAX_BATCH_OPERATIONS} operations`),
+  body('operations.*.type').isIn(OPERATION_TYPES).withMessage('Unknown operation type'),
+  body('operations.*.connectionId').isUUID().withMessage('Invalid connection ID format'),
+  body('operations.*.database').isString().notEmpty().withMessage('Database name is required'),
+  body('operations.*.collection').isString().notEmpty().withMessage('Collection name is required'),
+  body('ordered').optional().isBoolean().withMessage('ordered must be a boolean'),
+];
+
+// Helper function to check validation results
+const checkValidation = (req: Request, res: Response) => {
+  const errors = validationResult(req);
+  if (!errors.isEmpty()) {
+    return res.status(400).json({
+      success: false,
+      error: 'Validation failed',
+      details: errors.array(),
+      timestamp: new Date().toISOString(),
+    });
+  }
+  return null;
+};
+
+const withStringId = (doc: any) => ({ ...doc, _id: doc._id?.toString() });
+
+// Run one operation; failures become a result instead of failing the batch
+const runOperation = async (connectionManager: ConnectionManager, op: BatchOperation): Promise<BatchOperationResult> => {
+  const connection = connectionManager.getConnection(op.connectionId);
+  if (!connection) {
+    return { success: false, error: 'Connection not found', code: 'CONNECTION_NOT_FOUND' };
+  }
+
+  const collection = connection.client.db(op.database).collection(op.collection);
+  const filter = op.filter || {};
+  const options = op.options || {};
+
+  try {
+    switch (op.type) {
+      case 'insertOne': {
+        const result = await collection.insertOne(op.document);
+        return { success: true, data: { insertedId: result.insertedId.toString() } };
+      }
+      case 'insertMany': {
+        const result = await collection.insertMany(op.documents || [], { ordered: false });
+        return {
+          success: true,
+          data: {
+            insertedCount: result.insertedCount,
+            insertedIds: Object.values(result.insertedIds).map((id: any) => id.toString()),
+          },
+        };
+      }
+      case 'updateOne':
+      case 'updateMany': {
+        const update = { upsert: options.upsert === true };
+        const result = op.type === 'updateOne'
+          ? await collection.updateOne(filter, op.update, update)
+          : await collection.updateMany(filter, op.update, update);
+        return {
+          success: true,
+          data: {
+            matchedCount: result.matchedCount,
+            modifiedCount: result.modifiedCount,
+            upsertedCount: result.upsertedCount || 0,
+            upsertedId: result.upsertedId?.toString(),
+          },
+        };
+      }
+      case 'deleteOne':
+      case 'deleteMany': {
+        const result = op.type === 'deleteOne' ? await collection.deleteOne(filter) : await collection.deleteMany(filter);
+        return { success: true, data: { deletedCount: result.deletedCount } };
+      }
+      case 'findOne': {
+        const document = await collection.findOne(filter, options.projection ? { projection: options.projection } : {});
+        return { success: true, data: document ? withStringId(document) : null };
+      }
+      case 'find': {
+        const cursor = collection.find(filter);
+        if (options.limit) cursor.limit(options.limit);
+        if (options.skip) cursor.skip(options.skip);
+        if (options.sort) cursor.sort(options.sort);
+        if (options.projection) cursor.project(options.projection);
+        const documents: MongoDocument[] = await cursor.toArray();
+        return { success: true, data: documents.map(withStringId) };
+      }
+      case 'count':
+        return { success: true, data: { count: await collection.countDocuments(filter) } };
+      default:
+        return { success: false, error: `Unknown operation type ${op.type}`, code: 'INVALID_OPERATION' };
+    }
+  } catch (error) {
+    const message = error instanceof Error ? error.message : 'Operation failed';
+    const unavailable = error instanceof Error && isDatabaseUnavailable(error);
+    return { success: false, error: message, code: unavailable ? 'DATABASE_UNAVAILABLE' : 'OPERATION_FAILED' };
+  }
+};
+
+/**
+ * POST /
+ * Run operations on any collections of any connections in one request.
+ * Unordered batches run the operations of different collections concurrently;
+ * operations on the same collection still run in request order. Ordered
+ * batches run one operation at a time and stop at the first failure.
+ */
+router.post('/',
+  validateBatch,
+  asyncHandler(async (req: Request, res: Response) => {
+    const validationError = checkValidation(req, res);
+    if (validationError) return;
+
+    const connectionManager: ConnectionManager = req.app.locals['connectionManager'];
+    const { operations, ordered = false }: BatchRequest = req.body;
+
+    const skipped: BatchOperationResult = {
+      success: false,
+      error: 'Not run because an earlier operation failed',
+      code: 'SKIPPED',
+    };
+    const results: BatchOperationResult[] = new Array(operations.length).fill(skipped);
+
+    // Operations grouped by collection, in request order
+    const groups = new Map<string, number[]>();
+    operations.forEach((op, index) => {
+      const key = `${op.connectionId}/${op.database}/${op.collection}`;
+      const group = groups.get(key);
+      if (group) group.push(index);
+      else groups.set(key, [index]);
+    });
+
+    logger.info('Executing batch', {
+      operationCount: operations.length,
+      collectionCount: groups.size,
+      ordered
+    });
+
+    if (ordered) {
+      for (let i = 0; i < operations.length; i++) {
+        results[i] = await runOperation(connectionManager, operations[i]!);
+        if (!results[i]!.success) break;
+      }
+    } else {
+      await Promise.all(Array.from(groups.values()).map(async (indexes) => {
+        for (const i of indexes) {
+          results[i] = await runOperation(connectionManager, operations[i]!);
+        }
+      }));
+    }
+
+    const succeeded = results.filter((result) => result.success).length;
+    const skippedCount = results.filter((result) => result === skipped).length;
+
+    if (succeeded < operations.length) {
+      logger.warn('Batch completed with errors', {
+        operationCount: operations.length,
+        failed: operations.length - succeeded - skippedCount,
+        skipped: skippedCount
+      });
+    }
+
+    const response: ApiResponse<BatchResult> = {
+      success: true,
+      data: {
+        succeeded,
+        failed: operations.length - succeeded - skippedCount,
+        skipped: skippedCount,
+        results,
+      },
+      timestamp: new Date().toISOString(),
+    };
+
+    res.json(response);
+  })
+);
 
 export { router as batchRoutes };
@@ -26,6 +26,25 @@ const validateInsertOne = [
   body('document').isObject().withMessage('Document must be an object'),
 ];
 
+const validateUpdate = [
+  body('filter').optional().isObject().withMessage('Filter must be an object'),
+  body('upsert').optional().isBoolean().withMessage('Upsert must be a boolean'),
+  body('options.upsert').optional().isBoolean().withMessage('Upsert must be a boolean'),
+];
+
+const validateTimeSeries = [
+  body('timeField').optional().isString().notEmpty().withMessage('timeField must be a field name'),
+  body('metaField').optional().isString().notEmpty().withMessage('metaField must be a field name'),
+  body('granularity').optional().isIn(['seconds', 'minutes', 'hours']).withMessage('granularity must be seconds, minutes or hours'),
+  body('expireAfterSeconds').optional().isInt({ min: 1 }).withMessage('expireAfterSeconds must be a positive integer'),
+];
+
+const validateFindOneAndUpdate = [
+  ...validateUpdate,
+  body('update').exists().withMessage('Update is required'),
+  body('returnDocument').optional().isIn(['before', 'after']).withMessage('returnDocument must be "before" or "after"'),
+];
+
 // const validateFind = [
 //   body('filter').optional().isObject().withMessage('Filter must be an object'),
 //   body('options.limit').optional().isInt({ min: 1, max: 1000 }).withMessage('Limit must be between 1 and 1000'),
@@ -194,13 +213,14 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/find',
  * Update a single document (using POST for consistency)
  */
 router.post('/:connectionId/databases/:db/collections/:coll/documents/updateOne',
-  [...validateConnectionId, ...validateDbCollection],
+  [...validateConnectionId, ...validateDbCollection, ...validateUpdate],
   asyncHandler(async (req: Request, res: Response) => {
     const validationError = checkValidation(req, res);
     if (validationError) return;
 
     const collection = getCollection(req);
-    const { filter, update, options = {} } = req.body;
+    const { filter, update, upsert, options = {} } = req.body;
+    const updateOptions = upsert === undefined ? options : { ...options, upsert };
 
     logger.info('Updating document', {
       connectionId: req.params['connectionId'],
@@ -210,7 +230,7 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/updateOne'
     });
 
     try {
-      const result = await collection.updateOne(filter, update, options);
+      const result = await collection.updateOne(filter, update, updateOptions);
 
       const response: ApiResponse<{
         matchedCount: number;
@@ -244,13 +264,14 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/updateOne'
  * Update multiple documents (using POST for consistency)
  */
 router.post('/:connectionId/databases/:db/collections/:coll/documents/updateMany',
-  [...validateConnectionId, ...validateDbCollection],
+  [...validateConnectionId, ...validateDbCollection, ...validateUpdate],
   asyncHandler(async (req: Request, res: Response) => {
     const validationError = checkValidation(req, res);
     if (validationError) return;
 
     const collection = getCollection(req);
-    const { filter, update, options = {} } = req.body;
+    const { filter, update, upsert, options = {} } = req.body;
+    const updateOptions = upsert === undefined ? options : { ...options, upsert };
 
     logger.info('Updating multiple documents', {
       connectionId: req.params['connectionId'],
@@ -260,13 +281,14 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/updateMany
     });
 
     try {
-      const result = await collection.updateMany(filter, update, options);
+      const result = await collection.updateMany(filter, update, updateOptions);
 
       const response: ApiResponse<{
         matchedCount: number;
         modifiedCount: number;
         acknowledged: boolean;
         upsertedCount: number;
+        upsertedId?: string;
       }> = {
         success: true,
         data: {
@@ -274,6 +296,7 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/updateMany
           modifiedCount: result.modifiedCount,
           acknowledged: result.acknowledged,
           upsertedCount: result.upsertedCount || 0,
+          upsertedId: result.upsertedId?.toString(),
         },
         timestamp: new Date().toISOString(),
       };
@@ -289,6 +312,52 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/updateMany
   })
 );
 
+/**
+ * POST /:connectionId/databases/:db/collections/:coll/documents/findOneAndUpdate
+ * Update a single document and return it as it was before or after the update,
+ * in one atomic operation
+ */
+router.post('/:connectionId/databases/:db/collections/:coll/documents/findOneAndUpdate',
+  [...validateConnectionId, ...validateDbCollection, ...validateFindOneAndUpdate],
+  asyncHandler(async (req: Request, res: Response) => {
+    const validationError = checkValidation(req, res);
+    if (validationError) return;
+
+    const collection = getCollection(req);
+    const { filter = {}, update, upsert, returnDocument = 'after', options = {} } = req.body;
+
+    logger.info('Finding and updating document', {
+      connectionId: req.params['connectionId'],
+      database: req.params['db'],
+      collection: req.params['coll'],
+      filter,
+      returnDocument
+    });
+
+    try {
+      const document = await collection.findOneAndUpdate(filter, update, {
+        ...options,
+        ...(upsert === undefined ? {} : { upsert }),
+        returnDocument,
+      });
+
+      const response: ApiResponse<MongoDocument | null> = {
+        success: true,
+        data: document ? { ...document, _id: document._id.toString() } : null,
+        timestamp: new Date().toISOString(),
+      };
+
+      res.json(response);
+    } catch (error) {
+      throw createError(
+        error instanceof Error ? error.message : 'Find and update operation failed',
+        500,
+        'UPDATE_FAILED'
+      );
+    }
+  })
+);
+
 /**
  * POST /:connectionId/databases/:db/collections/:coll/documents/deleteOne
  * Delete a single document (using POST to support request body)
@@ -483,6 +552,21 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/bulkWrite'
       ordered
     });
 
+    // Counts and ids of a bulk write, also reported when some operations failed
+    const summarize = (result: any) => ({
+      insertedCount: result.insertedCount,
+      matchedCount: result.matchedCount,
+      modifiedCount: result.modifiedCount,
+      deletedCount: result.deletedCount,
+      upsertedCount: result.upsertedCount,
+      insertedIds: Object.fromEntries(
+        Object.entries(result.insertedIds || {}).map(([k, v]) => [k, (v as any).toString()])
+      ),
+      upsertedIds: Object.fromEntries(
+        Object.entries(result.upsertedIds || {}).map(([k, v]) => [k, (v as any).toString()])
+      ),
+    });
+
     try {
       const result = await collection.bulkWrite(operations, { ordered });
 
@@ -496,24 +580,36 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/bulkWrite'
         upsertedIds: { [key: number]: string };
       }> = {
         success: true,
-        data: {
-          insertedCount: result.insertedCount,
-          matchedCount: result.matchedCount,
-          modifiedCount: result.modifiedCount,
-          deletedCount: result.deletedCount,
-          upsertedCount: result.upsertedCount,
-          insertedIds: Object.fromEntries(
-            Object.entries(result.insertedIds || {}).map(([k, v]) => [k, (v as any).toString()])
-          ),
-          upsertedIds: Object.fromEntries(
-            Object.entries(result.upsertedIds || {}).map(([k, v]) => [k, (v as any).toString()])
-          ),
-        },
+        data: summarize(result),
         timestamp: new Date().toISOString(),
       };
 
       res.json(response);
     } catch (error) {
+      // MongoBulkWriteError: report what was written and which operations failed
+      const bulkError = error as any;
+      if (bulkError && bulkError.result && Array.isArray(bulkError.writeErrors)) {
+        logger.warn('Bulk write completed with errors', {
+          connectionId: req.params['connectionId'],
+          collection: req.params['coll'],
+          errorCount: bulkError.writeErrors.length
+        });
+
+        res.json({
+          success: true,
+          data: {
+            ...summarize(bulkError.result),
+            writeErrors: bulkError.writeErrors.map((writeError: any) => ({
+              index: writeError.index,
+              code: writeError.code,
+              message: writeError.errmsg,
+            })),
+          },
+          timestamp: new Date().toISOString(),
+        });
+        return;
+      }
+
       throw createError(
         error instanceof Error ? error.message : 'Bulk write operation failed',
         500,
@@ -669,18 +765,82 @@ router.delete('/:connectionId/databases/:db/collections/:coll/indexes/:indexName
   })
 );
 
+/**
+ * POST /:connectionId/databases/:db/collections/:coll/timeseries
+ * Create the collection as a time-series collection unless it already exists
+ */
+router.post('/:connectionId/databases/:db/collections/:coll/timeseries',
+  [...validateConnectionId, ...validateDbCollection, ...validateTimeSeries],
+  asyncHandler(async (req: Request, res: Response) => {
+    const validationError = checkValidation(req, res);
+    if (validationError) return;
+
+    const connectionManager: ConnectionManager = req.app.locals['connectionManager'];
+    const connection = connectionManager.getConnection(req.params['connectionId']!);
+    if (!connection) {
+      throw createError('Connection not found', 404, 'CONNECTION_NOT_FOUND');
+    }
+
+    const db = connection.client.db(req.params['db']!);
+    const name = req.params['coll']!;
+    const { timeField = 'timestamp', metaField, granularity = 'seconds', expireAfterSeconds } = req.body;
+
+    try {
+      const existing = await db.listCollections({ name }, { nameOnly: false }).toArray();
+      if (existing.length > 0) {
+        const info = existing[0] as any;
+        res.json({
+          success: true,
+          data: { created: false, timeSeries: info.type === 'timeseries' },
+          timestamp: new Date().toISOString(),
+        });
+        return;
+      }
+
+      await db.createCollection(name, {
+        timeseries: { timeField, ...(metaField ? { metaField } : {}), granularity },
+        ...(expireAfterSeconds ? { expireAfterSeconds } : {}),
+      });
+
+      logger.info('Created time-series collection', {
+        connectionId: req.params['connectionId'],
+        database: req.params['db'],
+        collection: name,
+        timeField,
+        metaField
+      });
+
+      res.status(201).json({
+        success: true,
+        data: { created: true, timeSeries: true },
+        timestamp: new Date().toISOString(),
+      });
+    } catch (error) {
+      throw createError(
+        error instanceof Error ? error.message : 'Time-series collection creation failed',
+        500,
+        'CREATE_COLLECTION_FAILED'
+      );
+    }
+  })
+);
+
 /**
  * POST /:connectionId/databases/:db/collections/:coll/documents/insertMany
  * Insert multiple documents
  */
 router.post('/:connectionId/databases/:db/collections/:coll/documents/insertMany',
-  [...validateConnectionId, ...validateDbCollection],
+  [
+    ...validateConnectionId,
+    ...validateDbCollection,
+    body('timeField').optional().isString().notEmpty().withMessage('timeField must be a field name'),
+  ],
   asyncHandler(async (req: Request, res: Response) => {
     const validationError = checkValidation(req, res);
     if (validationError) return;
 
     const collection = getCollection(req);
-    const { documents, options = {} } = req.body;
+    const { documents, options = {}, timeField } = req.body;
 
     if (!Array.isArray(documents) || documents.length === 0) {
       return res.status(400).json({
@@ -690,6 +850,15 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/insertMany
       });
     }
 
+    // JSON has no dates: timeField holds milliseconds since the epoch (event streams)
+    if (timeField) {
+      for (const document of documents) {
+        if (document && typeof document[timeField] === 'number') {
+          document[timeField] = new Date(document[timeField]);
+        }
+      }
+    }
+
     logger.info('Inserting multiple documents', {
       connectionId: req.params['connectionId'],
       database: req.params['db'],
@@ -697,23 +866,58 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/insertMany
       documentCount: documents.length
     });
 
+    // One id per document in request order; null where the document was not inserted
+    const alignIds = (insertedIds: any, writeErrors: any[]) => {
+      const ids: (string | null)[] = documents.map((_: any, index: number) =>
+        insertedIds && insertedIds[index] !== undefined ? insertedIds[index].toString() : null
+      );
+      const failed = writeErrors.map((writeError: any) => writeError.index as number);
+      // An ordered insert stops at its first error
+      const stop = options.ordered !== false && failed.length > 0 ? Math.min(...failed) : ids.length;
+      return ids.map((id, index) => (index >= stop || failed.includes(index) ? null : id));
+    };
+
     try {
       const result = await collection.insertMany(documents, options);
 
       const response: ApiResponse<{
         insertedCount: number;
-        insertedIds: string[];
+        insertedIds: (string | null)[];
       }> = {
         success: true,
         data: {
           insertedCount: result.insertedCount,
-          insertedIds: Object.values(result.insertedIds).map(id => (id as any).toString()),
+          insertedIds: alignIds(result.insertedIds, []),
         },
         timestamp: new Date().toISOString(),
       };
 
       return res.status(201).json(response);
     } catch (error) {
+      // MongoBulkWriteError: report which documents were inserted and which failed
+      const bulkError = error as any;
+      if (bulkError && bulkError.result && Array.isArray(bulkError.writeErrors)) {
+        logger.warn('Insert many completed with errors', {
+          connectionId: req.params['connectionId'],
+          collection: req.params['coll'],
+          errorCount: bulkError.writeErrors.length
+        });
+
+        return res.json({
+          success: true,
+          data: {
+            insertedCount: bulkError.result.insertedCount,
+            insertedIds: alignIds(bulkError.result.insertedIds, bulkError.writeErrors),
+            writeErrors: bulkError.writeErrors.map((writeError: any) => ({
+              index: writeError.index,
+              code: writeError.code,
+              message: writeError.errmsg,
+            })),
+          },
+          timestamp: new Date().toISOString(),
+        });
+      }
+
       throw createError(
         error instanceof Error ? error.message : 'Insert many operation failed',
         500,
@@ -723,4 +927,86 @@ router.post('/:connectionId/databases/:db/collections/:coll/documents/insertMany
   })
 );
 
+/**
+ * GET /:connectionId/databases/:db/collections/:coll/changes
+ * Server-sent event stream of the collection's change events.
+ * Each event carries the operation type and document _id so subscribers can
+ * invalidate cached copies; the event id is the change stream resume token.
+ */
+router.get('/:connectionId/databases/:db/collections/:coll/changes',
+  [...validateConnectionId, ...validateDbCollection],
+  asyncHandler(async (req: Request, res: Response) => {
+    const validationError = checkValidation(req, res);
+    if (validationError) return;
+
+    const collection = getCollection(req);
+
+    // Resume from the last event the client saw, if it sent one
+    let resumeAfter: any;
+    const lastEventId = req.header('Last-Event-ID');
+    if (lastEventId) {
+      try {
+        resumeAfter = JSON.parse(lastEventId);
+      } catch {
+        resumeAfter = undefined;
+      }
+    }
+
+    logger.info('Opening change stream', {
+      connectionId: req.params['connectionId'],
+      database: req.params['db'],
+      collection: req.params['coll'],
+      resumed: Boolean(resumeAfter)
+    });
+
+    const changeStream = collection.watch(
+      [{ $project: { operationType: 1, documentKey: 1 } }],
+      resumeAfter ? { resumeAfter } : {}
+    );
+
+    // no-transform keeps the compression middleware from buffering events
+    res.status(200);
+    res.setHeader('Content-Type', 'text/event-stream');
+    res.setHeader('Cache-Control', 'no-cache, no-transform');
+    res.setHeader('Connection', 'keep-alive');
+    res.setHeader('X-Accel-Buffering', 'no');
+    res.flushHeaders();
+
+    res.write(`event: ready\ndata: ${JSON.stringify({ resumed: Boolean(resumeAfter) })}\n\n`);
+
+    const heartbeat = setInterval(() => {
+      res.write(': ping\n\n');
+    }, 15000);
+
+    const cleanup = () => {
+      clearInterval(heartbeat);
+      changeStream.close().catch(() => undefined);
+    };
+
+    changeStream.on('change', (change: any) => {
+      const event = {
+        operationType: change.operationType,
+        documentKey: change.documentKey
+          ? { ...change.documentKey, _id: change.documentKey._id?.toString() }
+          : undefined,
+      };
+      res.write(`id: ${JSON.stringify(change._id)}\nevent: change\ndata: ${JSON.stringify(event)}\n\n`);
+    });
+
+    changeStream.on('error', (error: Error) => {
+      logger.warn('Change stream failed', {
+        connectionId: req.params['connectionId'],
+        database: req.params['db'],
+        collection: req.params['coll'],
+        error: error.message
+      });
+      res.write(`event: error\ndata: ${JSON.stringify({ message: error.message })}\n\n`);
+      cleanup();
+      res.end();
+    });
+
+    req.on('close', cleanup);
+  })
+);
+
 export { router as databaseRoutes };
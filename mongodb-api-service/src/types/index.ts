@@ -61,8 +61,11 @@ export interface FindOptions {
 }
 
 // Operation types for batch processing
+export type BatchOperationType =
+  'insertOne' | 'insertMany' | 'updateOne' | 'updateMany' | 'deleteOne' | 'deleteMany' | 'find' | 'findOne' | 'count';
+
 export interface BatchOperation {
-  type: 'insertOne' | 'insertMany' | 'updateOne' | 'updateMany' | 'deleteOne' | 'deleteMany' | 'find' | 'findOne';
+  type: BatchOperationType;
   connectionId: string;
   database: string;
   collection: string;
@@ -70,13 +73,22 @@ export interface BatchOperation {
   documents?: MongoDocument[];
   filter?: MongoDocument;
   update?: MongoDocument;
-  options?: FindOptions;
+  options?: FindOptions & { upsert?: boolean };
 }
 
-export interface BatchResult {
+// Outcome of one batch operation; data has the same shape as the single-operation route's
+export interface BatchOperationResult {
   success: boolean;
-  results: any[];
-  errors: string[];
+  data?: any;
+  error?: string;
+  code?: string;
+}
+
+export interface BatchResult {
+  succeeded: number;
+  failed: number;
+  skipped: number; // not run because an ordered batch stopped
+  results: BatchOperationResult[];
 }
 
 // Index types
@@ -140,6 +152,7 @@ export interface DeleteRequest {
 
 export interface BatchRequest {
   operations: BatchOperation[];
+  ordered?: boolean;
 }
 
 // Advanced operation types
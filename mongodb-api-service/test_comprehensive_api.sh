@@ -294,9 +294,47 @@ test_endpoint "POST" "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/coll
     "{\"filter\": {\"name\": {\"\$regex\": \"^Bulk\"}}}" \
     "Delete all documents with names starting with 'Bulk'"
 
+# Test 26: Change Stream Subscription
+echo -e "${BLUE}=== Test 26: Change Stream Subscription ===${NC}"
+echo -e "${YELLOW}Testing: Server-sent change events (requires a replica set)${NC}"
+stream_output=$(curl -s -N --max-time 3 \
+    "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/collections/$TEST_COLLECTION/changes" || true)
+echo "Stream: $stream_output"
+echo "$stream_output" | grep -q 'event: ready' && log_info "✓ Change stream opened" || log_warn "✗ Change stream did not open"
+echo ""
+
+# Test 27: Batch Across Collections
+echo -e "${BLUE}=== Test 27: Batch Across Collections ===${NC}"
+test_endpoint "POST" "$API_V1/batch" \
+    "{\"ordered\":false,\"operations\":[
+        {\"type\":\"updateOne\",\"connectionId\":\"$CONNECTION_ID\",\"database\":\"$TEST_DB\",\"collection\":\"$TEST_COLLECTION\",
+         \"filter\":{\"name\":\"Frank\"},\"update\":{\"\$inc\":{\"score\":5}}},
+        {\"type\":\"insertOne\",\"connectionId\":\"$CONNECTION_ID\",\"database\":\"$TEST_DB\",\"collection\":\"${TEST_COLLECTION}_sessions\",
+         \"document\":{\"name\":\"Frank\",\"minutes\":42}},
+        {\"type\":\"count\",\"connectionId\":\"$CONNECTION_ID\",\"database\":\"$TEST_DB\",\"collection\":\"$TEST_COLLECTION\",
+         \"filter\":{\"status\":\"active\"}}
+    ]}" \
+    "Batch of an update, an insert and a count on two collections"
+
+# Test 28: Find One And Update with Upsert
+echo -e "${BLUE}=== Test 28: Find One And Update with Upsert ===${NC}"
+test_endpoint "POST" "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/collections/$TEST_COLLECTION/documents/findOneAndUpdate" \
+    "{\"filter\": {\"name\": \"Grace\"}, \"update\": {\"\$setOnInsert\": {\"score\": 0}, \"\$set\": {\"status\": \"active\"}}, \"upsert\": true, \"returnDocument\": \"after\"}" \
+    "Create or update Grace in one atomic request and return the new document"
+
+# Test 29: Time-Series Event Ingestion
+echo -e "${BLUE}=== Test 29: Time-Series Event Ingestion ===${NC}"
+test_endpoint "POST" "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/collections/${TEST_COLLECTION}_events/timeseries" \
+    "{\"timeField\": \"timestamp\", \"metaField\": \"meta\", \"granularity\": \"seconds\"}" \
+    "Create a time-series collection for events"
+
+test_endpoint "POST" "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/collections/${TEST_COLLECTION}_events/documents/insertMany" \
+    "{\"documents\": [{\"timestamp\": 1760000000000, \"meta\": {\"map\": \"de_dust2\"}, \"x\": 1.5, \"hit\": true}, {\"timestamp\": 1760000000015, \"meta\": {\"map\": \"de_dust2\"}, \"x\": 2.5, \"hit\": false}], \"options\": {\"ordered\": false}, \"timeField\": \"timestamp\"}" \
+    "Insert events with millisecond timestamps stored as dates"
+
 # ===== SECTION 4: ERROR HANDLING TESTS =====
 
-echo -e "${BLUE}=== Test 26: Error Handling ===${NC}"
+echo -e "${BLUE}=== Test 30: Error Handling ===${NC}"
 echo -e "${YELLOW}Testing error handling (these should fail gracefully):${NC}"
 
 # Test with invalid connection ID
@@ -316,21 +354,21 @@ curl -s -X POST \
 
 # ===== SECTION 5: FINAL TESTS AND CLEANUP =====
 
-# Test 27: Final Document Count
-echo -e "${BLUE}=== Test 27: Final Document Count ===${NC}"
+# Test 31: Final Document Count
+echo -e "${BLUE}=== Test 31: Final Document Count ===${NC}"
 test_endpoint "POST" "$API_V1/connections/$CONNECTION_ID/databases/$TEST_DB/collections/$TEST_COLLECTION/documents/count" \
     "{\"filter\": {}}" \
     "Final count of documents"
 
-# Test 28: Final Connection Health Check
-echo -e "${BLUE}=== Test 28: Final Connection Health Check ===${NC}"
+# Test 32: Final Connection Health Check
+echo -e "${BLUE}=== Test 32: Final Connection Health Check ===${NC}"
 test_endpoint "GET" \
     "$API_V1/connections/$CONNECTION_ID/health" \
     "" \
     "Final connection health check"
 
-# Test 29: Close Connection
-echo -e "${BLUE}=== Test 29: Close Connection ===${NC}"
+# Test 33: Close Connection
+echo -e "${BLUE}=== Test 33: Close Connection ===${NC}"
 test_endpoint "DELETE" "$API_V1/connections/$CONNECTION_ID" "" "Close MongoDB connection"
 
 echo -e "${GREEN}Comprehensive MongoDB API test suite completed!${NC}"
@@ -350,10 +388,14 @@ echo ""
 echo -e "${GREEN}✓ Advanced Features:${NC}"
 echo "  - Aggregation pipelines (simple and complex)"
 echo "  - Bulk write operations"
+echo "  - Upserts and findOneAndUpdate"
+echo "  - Batches across collections"
+echo "  - Time-series collections and event ingestion"
 echo "  - Find with projection"
 echo "  - Distinct value queries"
 echo "  - Index management (creation)"
 echo "  - Enhanced connection health monitoring"
+echo "  - Change stream subscription (server-sent events)"
 echo ""
 echo -e "${GREEN}✓ Error Handling:${NC}"
 echo "  - Invalid connection IDs"